@@ -0,0 +1,76 @@
+// draw speed of the alias sampler compared to std::discrete_distribution, for the sizes of the distributions
+// used by the mutators (4 and 16 entries) and by the coverage of a large pool (10M entries)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+
+#include "sampler.hpp"
+#include "rng.hpp"
+
+
+// seconds taken by n_draws draws of a sampler, with the sum of the drawn indices returned to keep them alive
+template <typename Sampler>
+double time_draws(Sampler &sampler, size_t n_draws, uint64_t &checksum) {
+    rng::set_substream(0, 1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_draws; i++) {
+        checksum += sampler(rng::rng);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// compare both samplers on a distribution with n_entries random weights, and check that the alias sampler 
+// reproduces the weights of the first entries
+bool compare(size_t n_entries, size_t n_draws) {
+    std::mt19937 generator(n_entries);
+    std::uniform_real_distribution<double> uniform(0.1, 1.0);
+    std::vector<double> weights(n_entries);
+    for (double &weight : weights) {
+        weight = uniform(generator);
+    }
+
+    std::discrete_distribution<uint32_t> discrete(weights.begin(), weights.end());
+    sampler::AliasSampler alias(weights);
+
+    uint64_t checksum = 0;
+    double t_discrete = time_draws(discrete, n_draws, checksum);
+    double t_alias = time_draws(alias, n_draws, checksum);
+    printf("%10zu entries: std::discrete_distribution %6.1f ns/draw, AliasSampler %6.1f ns/draw, speedup %.1fx\n",
+        n_entries, 1e9 * t_discrete / n_draws, 1e9 * t_alias / n_draws, t_discrete / t_alias);
+
+    // the frequency of each of the first entries must match its probability
+    if (n_entries > 16) {
+        return true;
+    }
+    std::vector<size_t> counts(n_entries, 0);
+    rng::set_substream(0, 2);
+    for (size_t i = 0; i < n_draws; i++) {
+        counts[alias(rng::rng)]++;
+    }
+    double total = 0.0;
+    for (double weight : weights) {
+        total += weight;
+    }
+    for (size_t i = 0; i < n_entries; i++) {
+        double expected = weights[i] / total;
+        double observed = (double)counts[i] / n_draws;
+        if (std::abs(observed - expected) > 5 * std::sqrt(expected * (1 - expected) / n_draws)) {
+            printf("entry %zu drawn with frequency %f instead of %f\n", i, observed, expected);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_draws = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    bool ok = compare(4, n_draws) && compare(16, n_draws) && compare(10000000, n_draws);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
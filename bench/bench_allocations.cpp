@@ -0,0 +1,137 @@
+// allocation check of the steady state of the pipeline, running the steps of a task of the pipeline over and over for
+// both challenges and both stages, and checking that neither the oligo buffers nor the scratch arenas allocate any
+// memory once the buffers of all batches have grown to their final size
+// the buffers of the reads circulate through all slots of the writer queues, such that the warm-up has to pass each
+// slot several times before all of them have grown; the batches of a task stay below the size a writer keeps for reuse
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "constants.hpp"
+#include "fileio.hpp"
+#include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "oligocollector.hpp"
+#include "oligofactory.hpp"
+#include "rng.hpp"
+#include "scenarios.hpp"
+
+
+// random design sequences of the given length
+std::vector<std::vector<char>> random_sequences(size_t n_sequences, size_t length) {
+    const char bases[4] = {constants::NUCLEOTIDE_A, constants::NUCLEOTIDE_C, constants::NUCLEOTIDE_G, constants::NUCLEOTIDE_T};
+    rng::set_substream(0, 0);
+    std::vector<std::vector<char>> sequences(n_sequences, std::vector<char>(length));
+    for (std::vector<char> &sequence : sequences) {
+        for (char &base : sequence) {
+            base = bases[rng::random_int(0, 3)];
+        }
+    }
+    return sequences;
+}
+
+
+// run the steps of a single task of the pipeline for the copies of one sequence, and write the reads
+void run_task(
+    oligocollector::OligoCollector &collector,
+    std::vector<char> const &sequence,
+    std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators,
+    size_t i_task,
+    oligocollector::CollectedReads &reads
+    ) {
+    static oligobatch::OligoBatch oligos;
+    oligos.clear();
+    oligos.reserve(constants::COPIES_PER_TASK, constants::COPIES_PER_TASK * sequence.size());
+    rng::set_substream(constants::RNG_STREAM_SYNTHESIS, i_task);
+    arena::resource()->reset();
+    oligofactory::generate_oligos(oligos, sequence, constants::COPIES_PER_TASK, mutators);
+
+    arena::resource()->reset();
+    rng::set_substream(constants::RNG_STREAM_READS, i_task, 1);
+    collector.prepare_reads(oligos, reads);
+    collector.write_reads(reads);
+}
+
+
+// run the tasks of one stage after a warm-up, and check that the measured tasks do not allocate
+bool check_stage(
+    const char *name,
+    oligocollector::OligoCollector &collector,
+    std::vector<std::vector<char>> const &sequences,
+    std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators,
+    size_t n_warmup,
+    size_t n_tasks
+    ) {
+    oligocollector::CollectedReads reads;
+    for (size_t i = 0; i < n_warmup; i++) {
+        run_task(collector, sequences[i % sequences.size()], mutators, i, reads);
+    }
+
+    uint64_t heap_allocations = arena::count_heap_allocations();
+    uint64_t batch_allocations = oligobatch::count_allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = n_warmup; i < n_warmup + n_tasks; i++) {
+        run_task(collector, sequences[i % sequences.size()], mutators, i, reads);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    heap_allocations = arena::count_heap_allocations() - heap_allocations;
+    batch_allocations = oligobatch::count_allocations() - batch_allocations;
+
+    printf("%-28s %zu tasks of %u copies in %.2f s, %llu arena blocks, %llu oligo buffers allocated\n", name, n_tasks,
+        constants::COPIES_PER_TASK, seconds, (unsigned long long)heap_allocations, (unsigned long long)batch_allocations);
+    return heap_allocations == 0 && batch_allocations == 0;
+}
+
+
+// check both stages of a challenge, whose mutators are set up by the given scenario
+template <typename Scenario>
+bool check_challenge(const char *name, Scenario scenario, std::vector<std::vector<char>> const &sequences, size_t n_warmup, size_t n_tasks) {
+    float initial_coverage_bias, mean_physical_coverage, mean_sequencing_coverage;
+    int read_length;
+    std::vector<std::unique_ptr<mutator::BaseMutator>> initial_mutators, recovery_mutators, sequencing_mutators;
+    scenario(initial_coverage_bias, mean_physical_coverage, mean_sequencing_coverage, read_length, initial_mutators, recovery_mutators);
+    scenarios::sequencing(true, true, read_length, sequencing_mutators);
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    bool ok = true;
+    {
+        fileio::SequenceFileWriter writer((directory / "bench_allocations.bin").string(), fileio::WriteFileType::BINARY);
+        oligocollector::OligoCollector collector(writer);
+        collector.set_collapse_duplicates(true);
+        ok = check_stage((std::string(name) + " synthesis").c_str(), collector, sequences, initial_mutators, n_warmup, n_tasks) && ok;
+        collector.finish();
+        writer.remove();
+    }
+    {
+        fileio::SequenceFileWriter writer_fw((directory / "bench_allocations.1").string());
+        fileio::SequenceFileWriter writer_rv((directory / "bench_allocations.2").string());
+        oligocollector::OligoCollector collector(writer_fw, writer_rv);
+        collector.set_mutators(sequencing_mutators);
+        ok = check_stage((std::string(name) + " sequencing").c_str(), collector, sequences, recovery_mutators, n_warmup, n_tasks) && ok;
+        collector.finish();
+        writer_fw.remove();
+        writer_rv.remove();
+    }
+    return ok;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_tasks = argc > 1 ? std::stoull(argv[1]) : 10000;
+    size_t n_warmup = argc > 2 ? std::stoull(argv[2]) : 16 * constants::WRITER_QUEUE_CAPACITY;
+    std::vector<std::vector<char>> sequences = random_sequences(64, 150);
+
+    bool ok = check_challenge("decay", scenarios::challenge_decay, sequences, n_warmup, n_tasks);
+    ok = check_challenge("photolithography", scenarios::challenge_photolithography, sequences, n_warmup, n_tasks) && ok;
+    if (!ok) {
+        printf("memory was allocated in the steady state\n");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,107 @@
+// fragments produced per second by the breakage and size selection of the decay challenge, fused into a single
+// BreakageSelection compared to BreakageEvents followed by SizeSelection, and check that both select fragments with the
+// same length distribution
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "constants.hpp"
+#include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "rng.hpp"
+
+
+// random design sequences of the given length
+std::vector<std::vector<char>> random_sequences(size_t n_sequences, size_t length) {
+    const char bases[4] = {constants::NUCLEOTIDE_A, constants::NUCLEOTIDE_C, constants::NUCLEOTIDE_G, constants::NUCLEOTIDE_T};
+    rng::set_substream(0, 0);
+    std::vector<std::vector<char>> sequences(n_sequences, std::vector<char>(length));
+    for (std::vector<char> &sequence : sequences) {
+        for (char &base : sequence) {
+            base = bases[rng::random_int(0, 3)];
+        }
+    }
+    return sequences;
+}
+
+
+// seconds taken to process a batch of copies of each sequence, with the number of selected fragments of each length
+struct Timing {
+    double seconds;
+    size_t n_fragments;
+    std::vector<size_t> lengths;
+};
+
+template <typename Process>
+Timing time_batches(std::vector<std::vector<char>> const &sequences, unsigned int n_copies, Process process) {
+    oligobatch::OligoBatch oligos;
+    Timing timing = {0.0, 0, std::vector<size_t>(sequences[0].size() + 1, 0)};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sequences.size(); i++) {
+        oligos.clear();
+        oligos.push_back(sequences[i], n_copies);
+        rng::set_substream(constants::RNG_STREAM_SYNTHESIS, i);
+        arena::resource()->reset();
+        process(oligos);
+        timing.n_fragments += oligos.size();
+        for (size_t j = 0; j < oligos.size(); j++) {
+            timing.lengths[oligos.length(j)]++;
+        }
+    }
+    timing.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return timing;
+}
+
+
+// check that the fraction of fragments of each length only differs by chance
+bool same_lengths(Timing const &a, Timing const &b) {
+    bool ok = true;
+    for (size_t length = 0; length < a.lengths.size(); length++) {
+        double p_a = (double)a.lengths[length] / a.n_fragments;
+        double p_b = (double)b.lengths[length] / b.n_fragments;
+        double p = (double)(a.lengths[length] + b.lengths[length]) / (a.n_fragments + b.n_fragments);
+        double tolerance = 5 * std::sqrt(p * (1 - p) * (1.0 / a.n_fragments + 1.0 / b.n_fragments)) + 1e-9;
+        if (std::abs(p_a - p_b) > tolerance) {
+            printf("%.5f of the fused fragments but %.5f of the separate ones are %zu nt long\n", p_a, p_b, length);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_batches = argc > 1 ? std::stoull(argv[1]) : 800;
+    unsigned int n_copies = argc > 2 ? std::stoul(argv[2]) : 512;
+    std::vector<std::vector<char>> sequences = random_sequences(n_batches, 150);
+
+    mutator::BreakageEvents breakage(0.023, {0.3902, 0.0488, 0.4878, 0.0732});
+    mutator::SizeSelection selection(60-33-8, 140-33-8);
+    mutator::BreakageSelection fused(breakage, selection);
+
+    Timing separate_timing = time_batches(sequences, n_copies, [&](oligobatch::OligoBatch &oligos) {
+        breakage.process_batch(oligos);
+        selection.process_batch(oligos);
+    });
+    Timing fused_timing = time_batches(sequences, n_copies, [&](oligobatch::OligoBatch &oligos) {
+        fused.process_batch(oligos);
+    });
+
+    printf("separate %.2f M fragments/s, fused %.2f M fragments/s, speedup %.2fx, %.3f and %.3f fragments per copy\n",
+        1e-6 * separate_timing.n_fragments / separate_timing.seconds, 1e-6 * fused_timing.n_fragments / fused_timing.seconds,
+        separate_timing.seconds / fused_timing.seconds, (double)separate_timing.n_fragments / (n_batches * n_copies),
+        (double)fused_timing.n_fragments / (n_batches * n_copies));
+
+    bool ok = same_lengths(fused_timing, separate_timing);
+    double fragments_ratio = (double)fused_timing.n_fragments / separate_timing.n_fragments;
+    if (std::abs(fragments_ratio - 1.0) > 0.01) {
+        printf("the fused mutator selects %.4f times the fragments of the separate ones\n", fragments_ratio);
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+// per-oligo throughput of the sequencing chain, built as a single chain whose types are fixed at compile time compared
+// to the same mutators called one after another through the virtual interface, and check that both produce the same
+// number of oligos with the same mean length
+// the synthesis and aging of both challenges showed no gain from a chain and call their mutators one after another
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "constants.hpp"
+#include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "oligofactory.hpp"
+#include "rng.hpp"
+#include "scenarios.hpp"
+
+using namespace scenarios;
+typedef std::vector<std::unique_ptr<mutator::BaseMutator>> Mutators;
+
+
+// random design sequences of the given length
+std::vector<std::vector<char>> random_sequences(size_t n_sequences, size_t length) {
+    const char bases[4] = {constants::NUCLEOTIDE_A, constants::NUCLEOTIDE_C, constants::NUCLEOTIDE_G, constants::NUCLEOTIDE_T};
+    rng::set_substream(0, 0);
+    std::vector<std::vector<char>> sequences(n_sequences, std::vector<char>(length));
+    for (std::vector<char> &sequence : sequences) {
+        for (char &base : sequence) {
+            base = bases[rng::random_int(0, 3)];
+        }
+    }
+    return sequences;
+}
+
+
+// seconds taken to generate the copies of all sequences, with the number of oligos and bases generated
+struct Timing {
+    double seconds;
+    size_t n_oligos;
+    size_t n_bases;
+};
+
+Timing time_chain(Mutators &mutators, std::vector<std::vector<char>> const &sequences, unsigned int n_copies) {
+    oligobatch::OligoBatch oligos;
+    Timing timing = {0.0, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sequences.size(); i++) {
+        oligos.clear();
+        rng::set_substream(constants::RNG_STREAM_SYNTHESIS, i);
+        arena::resource()->reset();
+        oligofactory::generate_oligos(oligos, sequences[i], n_copies, mutators);
+        timing.n_oligos += oligos.size();
+        for (size_t j = 0; j < oligos.size(); j++) {
+            timing.n_bases += oligos.length(j);
+        }
+    }
+    timing.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return timing;
+}
+
+
+// seconds taken to pass batches of the copies of all sequences through the mutators, as the reads of the sequencing are
+Timing time_batches(Mutators &mutators, std::vector<std::vector<char>> const &sequences, unsigned int n_copies) {
+    oligobatch::OligoBatch oligos;
+    Timing timing = {0.0, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sequences.size(); i++) {
+        oligos.clear();
+        oligos.push_back(sequences[i], n_copies);
+        rng::set_substream(constants::RNG_STREAM_READS, i);
+        arena::resource()->reset();
+        for (std::unique_ptr<mutator::BaseMutator> &mutator : mutators) {
+            mutator->process_batch(oligos);
+        }
+        timing.n_oligos += oligos.size();
+        for (size_t j = 0; j < oligos.size(); j++) {
+            timing.n_bases += oligos.length(j);
+        }
+    }
+    timing.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return timing;
+}
+
+
+// compare both ways of calling the mutators, the oligos they generate may only differ by chance
+template <typename Time>
+bool compare(const char *name, Mutators &static_chain, Mutators &virtual_chain, std::vector<std::vector<char>> const &sequences, unsigned int n_copies, Time time) {
+    size_t n_copies_total = sequences.size() * n_copies;
+    Timing virtual_timing = time(virtual_chain, sequences, n_copies);
+    Timing static_timing = time(static_chain, sequences, n_copies);
+    printf("%-16s virtual %7.1f ns/oligo, static chain %7.1f ns/oligo, speedup %.2fx, %.3f oligos of %.2f nt per copy\n",
+        name, 1e9 * virtual_timing.seconds / n_copies_total, 1e9 * static_timing.seconds / n_copies_total,
+        virtual_timing.seconds / static_timing.seconds, (double)static_timing.n_oligos / n_copies_total,
+        (double)static_timing.n_bases / static_timing.n_oligos);
+
+    double oligos_ratio = (double)static_timing.n_oligos / virtual_timing.n_oligos;
+    double length_ratio = ((double)static_timing.n_bases / static_timing.n_oligos) / ((double)virtual_timing.n_bases / virtual_timing.n_oligos);
+    if (std::abs(oligos_ratio - 1.0) > 0.01 || std::abs(length_ratio - 1.0) > 0.01) {
+        printf("%s: the static chain generates %.4f times the oligos with %.4f times the mean length of the virtual one\n", name, oligos_ratio, length_ratio);
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_sequences = argc > 1 ? std::stoull(argv[1]) : 20000;
+    std::vector<std::vector<char>> sequences = random_sequences(n_sequences, 150);
+    bool ok = true;
+
+    // the sequencing chain with adapters and padding, applied to each read and to whole batches of reads, as in the 
+    // collector
+    {
+        Mutators static_chain, virtual_chain;
+        sequencing(true, true, 150, static_chain);
+        virtual_chain.push_back(std::make_unique<mutator::SequencingAddAdapter>("AGATCGGAAGAGC"));
+        virtual_chain.push_back(std::make_unique<mutator::SequencingPadTrim>(150));
+        virtual_chain.push_back(std::make_unique<mutator::SubstitutionEvents>(0.0018115, std::vector<float>{0.0029, 0.2065, 0.1684, 0.0246, 0.0139, 0.1594, 0.1761, 0.0184, 0.0377, 0.0203, 0.1060, 0.0657}));
+        ok = compare("sequencing", static_chain, virtual_chain, sequences, constants::COPIES_PER_TASK, time_chain) && ok;
+        ok = compare("sequencing batch", static_chain, virtual_chain, sequences, constants::COPIES_PER_TASK, time_batches) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
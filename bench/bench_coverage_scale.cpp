@@ -0,0 +1,48 @@
+// scale test of the coverage sampling for a pool of 1e8 design sequences at the photolithography defaults, checking 
+// that the oligo totals exceeding 32 bits are drawn exactly and that the mean coverage derived from them is exact
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "coverage.hpp"
+#include "rng.hpp"
+
+
+// check that the counts add up to the expected total and give the expected mean coverage
+bool check_total(const char *stage, std::vector<unsigned int> const &counts, uint64_t expected_total, double expected_mean) {
+    uint64_t total = std::accumulate(counts.begin(), counts.end(), (uint64_t)0);
+    double mean = (double)total / (double)counts.size();
+    printf("%s: %llu oligos over %zu sequences, mean coverage %.6f\n", stage, (unsigned long long)total, counts.size(), mean);
+    if (total != expected_total || mean != expected_mean) {
+        printf("%s: expected %llu oligos and a mean coverage of %.6f\n", stage, (unsigned long long)expected_total, expected_mean);
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    uint64_t n_sequences = argc > 1 ? std::stoull(argv[1]) : 100000000;
+    int n_threads = argc > 2 ? std::stoi(argv[2]) : 1;
+    const float coverage_bias = 0.44;
+    const float mean_physical_coverage = 200;
+    auto start = std::chrono::steady_clock::now();
+
+    // same steps as the synthesis and sampling of the pipeline
+    rng::set_substream(0, 0);
+    std::vector<unsigned int> initial_coverage = coverage::get_initial_coverage(n_sequences, coverage_bias, 100, n_threads);
+    bool ok = check_total("initial coverage", initial_coverage, n_sequences * 100, 100.0);
+
+    uint64_t n_sampled_oligos = (uint64_t) ((double) n_sequences * mean_physical_coverage);
+    rng::set_substream(0, 1);
+    std::vector<unsigned int> physical_coverage = coverage::sample_by_count(initial_coverage, n_sampled_oligos, n_threads);
+    ok = check_total("physical coverage", physical_coverage, n_sequences * 200, 200.0) && ok;
+
+    printf("sampled in %.1f s\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,290 @@
+// check that the error channel, which applies substitutions, deletions and insertions in a single pass, results in
+// the same distribution of oligos as the substitution, deletion and insertion mutators applied one after another,
+// for each way the error channel is called:
+// - first event: the factory draws the copies without any event at once and the others from their first event
+// - hazard table: the factory hands each copy to the channel with the tables of its sequence, as when another mutator
+//   without event probabilities follows the channel
+// - batch: all copies are processed as a batch, without any table
+// the oligos are compared by the distribution of their length, the number of substitutions, deletions and insertions
+// found by aligning them to their design sequence, and the number of each base
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+#include "constants.hpp"
+#include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "oligofactory.hpp"
+#include "rng.hpp"
+
+typedef std::vector<std::unique_ptr<mutator::BaseMutator>> Mutators;
+
+
+// mutator without event probabilities that leaves the oligo as it is, such that the factory does not draw the copies
+// from their first event and hands the tables to the mutators before it instead
+class Unchanged : public mutator::BaseMutator {
+    private:
+        virtual void process_single(std::vector<char> &oligo) override {}
+};
+
+
+// random design sequences of the given length
+std::vector<std::vector<char>> random_sequences(size_t n_sequences, size_t length) {
+    const char bases[4] = {constants::NUCLEOTIDE_A, constants::NUCLEOTIDE_C, constants::NUCLEOTIDE_G, constants::NUCLEOTIDE_T};
+    rng::set_substream(0, 0);
+    std::vector<std::vector<char>> sequences(n_sequences, std::vector<char>(length));
+    for (std::vector<char> &sequence : sequences) {
+        for (char &base : sequence) {
+            base = bases[rng::random_int(0, 3)];
+        }
+    }
+    return sequences;
+}
+
+
+// number of substitutions, deletions and insertions of the alignment with the fewest edits of an oligo to its design
+// sequence, ties are resolved in the same way for all oligos
+std::array<int, 3> count_edits(std::vector<char> const &sequence, std::string_view oligo) {
+    if (oligo == std::string_view(sequence.data(), sequence.size())) {
+        return {0, 0, 0};
+    }
+    const size_t n = sequence.size(), m = oligo.size();
+    static std::vector<int> cost;
+    cost.assign((n + 1) * (m + 1), 0);
+    auto at = [&](size_t i, size_t j) -> int & { return cost[i * (m + 1) + j]; };
+    for (size_t i = 0; i <= n; i++) at(i, 0) = i;
+    for (size_t j = 0; j <= m; j++) at(0, j) = j;
+    for (size_t i = 1; i <= n; i++) {
+        for (size_t j = 1; j <= m; j++) {
+            at(i, j) = std::min({at(i - 1, j - 1) + (sequence[i - 1] != oligo[j - 1]), at(i - 1, j) + 1, at(i, j - 1) + 1});
+        }
+    }
+
+    // trace the alignment back, preferring matches and substitutions over deletions over insertions
+    std::array<int, 3> edits = {0, 0, 0};
+    size_t i = n, j = m;
+    while (i > 0 || j > 0) {
+        if (i > 0 && j > 0 && at(i, j) == at(i - 1, j - 1) + (sequence[i - 1] != oligo[j - 1])) {
+            edits[0] += sequence[i - 1] != oligo[j - 1];
+            i--;
+            j--;
+        } else if (i > 0 && at(i, j) == at(i - 1, j) + 1) {
+            edits[1]++;
+            i--;
+        } else {
+            edits[2]++;
+            j--;
+        }
+    }
+    return edits;
+}
+
+
+// per-oligo statistics of all oligos generated in one way
+struct Statistics {
+    std::vector<int> lengths;
+    std::array<double, 7> sum = {}; // substitutions, deletions, insertions, and the count of each base
+    std::array<double, 7> sum_squares = {};
+
+    void add(std::vector<char> const &sequence, std::string_view oligo) {
+        lengths.push_back(oligo.size());
+        std::array<int, 3> edits = count_edits(sequence, oligo);
+        std::array<double, 7> values = {(double)edits[0], (double)edits[1], (double)edits[2], 0, 0, 0, 0};
+        for (char base : oligo) {
+            values[3 + base - 1]++;
+        }
+        for (size_t k = 0; k < values.size(); k++) {
+            sum[k] += values[k];
+            sum_squares[k] += values[k] * values[k];
+        }
+    }
+
+    double mean(size_t k) const { return sum[k] / lengths.size(); }
+    double variance(size_t k) const { return std::max(sum_squares[k] / lengths.size() - mean(k) * mean(k), 0.0); }
+};
+
+
+// the mutators applied one after another to each copy, without any table
+Statistics sequential(std::vector<std::vector<char>> const &sequences, unsigned int n_copies, Mutators &mutators) {
+    Statistics statistics;
+    std::vector<char> oligo;
+    for (size_t i = 0; i < sequences.size(); i++) {
+        rng::set_substream(constants::RNG_STREAM_SYNTHESIS, i);
+        for (unsigned int i_copy = 0; i_copy < n_copies; i_copy++) {
+            rng::set_copy(i_copy + 1);
+            arena::resource()->reset();
+            oligo = sequences[i];
+            for (std::unique_ptr<mutator::BaseMutator> &mutator : mutators) {
+                mutator->process(oligo);
+            }
+            statistics.add(sequences[i], std::string_view(oligo.data(), oligo.size()));
+        }
+    }
+    return statistics;
+}
+
+// the copies generated by the factory, which uses the tables of each sequence
+Statistics factory(std::vector<std::vector<char>> const &sequences, unsigned int n_copies, Mutators &mutators) {
+    Statistics statistics;
+    oligobatch::OligoBatch oligos;
+    for (size_t i = 0; i < sequences.size(); i++) {
+        oligos.clear();
+        rng::set_substream(constants::RNG_STREAM_SYNTHESIS, i);
+        arena::resource()->reset();
+        oligofactory::generate_oligos(oligos, sequences[i], n_copies, mutators);
+        for (size_t j = 0; j < oligos.size(); j++) {
+            statistics.add(sequences[i], oligos.view(j));
+        }
+    }
+    return statistics;
+}
+
+// all copies of a sequence processed as a batch
+Statistics batch(std::vector<std::vector<char>> const &sequences, unsigned int n_copies, Mutators &mutators) {
+    Statistics statistics;
+    oligobatch::OligoBatch oligos;
+    for (size_t i = 0; i < sequences.size(); i++) {
+        oligos.clear();
+        oligos.push_back(sequences[i], n_copies);
+        rng::set_substream(constants::RNG_STREAM_SYNTHESIS, i);
+        arena::resource()->reset();
+        for (std::unique_ptr<mutator::BaseMutator> &mutator : mutators) {
+            mutator->process_batch(oligos);
+        }
+        for (size_t j = 0; j < oligos.size(); j++) {
+            statistics.add(sequences[i], oligos.view(j));
+        }
+    }
+    return statistics;
+}
+
+
+// compare the oligos of the error channel to those of the mutators one after another, the lengths by the two-sample
+// Kolmogorov-Smirnov statistic and the mean counts per oligo by their z-score
+bool compare(const char *scenario, const char *path, Statistics const &reference, Statistics const &channel) {
+    std::vector<int> a = reference.lengths, b = channel.lengths;
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    double ks = 0.0;
+    for (size_t i = 0, j = 0; i < a.size() && j < b.size();) {
+        int length = std::min(a[i], b[j]);
+        while (i < a.size() && a[i] == length) i++;
+        while (j < b.size() && b[j] == length) j++;
+        ks = std::max(ks, std::abs((double)i / a.size() - (double)j / b.size()));
+    }
+    // critical value at a significance level of 1e-4
+    double n = a.size(), m = b.size();
+    double ks_critical = std::sqrt(-0.5 * std::log(0.5e-4)) * std::sqrt((n + m) / (n * m));
+
+    const char *names[7] = {"substitutions", "deletions", "insertions", "A", "C", "G", "T"};
+    double max_z = 0.0;
+    bool ok = ks <= ks_critical;
+    if (!ok) {
+        printf("%s, %s: the lengths differ with a Kolmogorov-Smirnov statistic of %.5f above %.5f\n", scenario, path, ks, ks_critical);
+    }
+    for (size_t k = 0; k < 7; k++) {
+        double se = std::sqrt(reference.variance(k) / n + channel.variance(k) / m);
+        double z = se > 0.0 ? (channel.mean(k) - reference.mean(k)) / se : 0.0;
+        max_z = std::max(max_z, std::abs(z));
+        if (std::abs(z) > 5.0) {
+            printf("%s, %s: %.5f %s per oligo instead of %.5f (z = %.1f)\n", scenario, path, channel.mean(k), names[k], reference.mean(k), z);
+            ok = false;
+        }
+    }
+    printf("%-16s %-12s %.4f substitutions, %.4f deletions, %.4f insertions per oligo (sequential %.4f, %.4f, %.4f), length KS %.5f (critical %.5f), max |z| %.2f\n",
+        scenario, path, channel.mean(0), channel.mean(1), channel.mean(2), reference.mean(0), reference.mean(1), reference.mean(2), ks, ks_critical, max_z);
+    return ok;
+}
+
+
+// the substitution, deletion and insertion mutators of a scenario, some of which may be missing
+struct Scenario {
+    const char *name;
+    size_t length;
+    std::function<Mutators()> mutators;
+};
+
+bool check(Scenario const &scenario, size_t n_sequences, unsigned int n_copies) {
+    std::vector<std::vector<char>> sequences = random_sequences(n_sequences, scenario.length);
+
+    Mutators separate = scenario.mutators();
+    Statistics reference = sequential(sequences, n_copies, separate);
+
+    // the channel alone provides its event probabilities, such that the factory draws the copies from their first event
+    Mutators first_event = scenario.mutators();
+    mutator::fuse_error_channels(first_event);
+    if (first_event.size() != 1 || first_event[0]->get_name() != "ErrorChannel") {
+        printf("%s: the mutators were not fused into an error channel\n", scenario.name);
+        return false;
+    }
+
+    // a following mutator without event probabilities makes the factory hand the tables to the channel
+    Mutators hazard_table = scenario.mutators();
+    mutator::fuse_error_channels(hazard_table);
+    hazard_table.push_back(std::make_unique<Unchanged>());
+
+    // make sure each way of calling the channel is taken by the factory
+    if (oligofactory::get_sequence_tables(sequences[0], first_event).p_event_before.empty()
+        || !oligofactory::get_sequence_tables(sequences[0], hazard_table).p_event_before.empty()
+        || oligofactory::get_sequence_tables(sequences[0], hazard_table).cumulative_hazard[0].empty()) {
+        printf("%s: the factory does not draw the copies from their first event or from the tables\n", scenario.name);
+        return false;
+    }
+
+    Mutators batched = scenario.mutators();
+    mutator::fuse_error_channels(batched);
+
+    bool ok = compare(scenario.name, "first event", reference, factory(sequences, n_copies, first_event));
+    ok = compare(scenario.name, "hazard table", reference, factory(sequences, n_copies, hazard_table)) && ok;
+    ok = compare(scenario.name, "batch", reference, batch(sequences, n_copies, batched)) && ok;
+    return ok;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_sequences = argc > 1 ? std::stoull(argv[1]) : 200;
+    unsigned int n_copies = argc > 2 ? std::stoul(argv[2]) : 500;
+
+    std::vector<Scenario> scenarios = {
+        // the errors of photolithographic synthesis, with all three kinds of events and events longer than one base
+        {"photolithography", 60, []() {
+            Mutators mutators;
+            mutators.push_back(std::make_unique<mutator::SubstitutionEvents>(0.0212,
+                std::vector<float>{0.085, 0.058, 0.063, 0.088, 0.081, 0.063, 0.095, 0.073, 0.183, 0.081, 0.063, 0.094},
+                std::vector<float>{0.8420, 0.1277, 0.0232, 0.0071}));
+            mutators.push_back(std::make_unique<mutator::DeletionEvents>(0.0683,
+                std::vector<float>{0.25, 0.25, 0.25, 0.25},
+                std::vector<float>{0.8556, 0.1026, 0.0227, 0.0191}));
+            mutators.push_back(std::make_unique<mutator::InsertionEvents>(0.0136,
+                std::vector<float>{0.25, 0.25, 0.25, 0.25},
+                std::vector<float>{0.9275, 0.0453, 0.0126, 0.0146}));
+            return mutators;
+        }},
+        // the substitutions and deletions of the decay challenge at ten times their rates, such that enough copies
+        // have events, without insertions
+        {"decay x10", 150, []() {
+            Mutators mutators;
+            mutators.push_back(std::make_unique<mutator::SubstitutionEvents>(10 * 0.000109*15,
+                std::vector<float>{0.0147, 0.3028, 0.0630, 0.0150, 0.0071, 0.0975, 0.0975, 0.0071, 0.0150, 0.0630, 0.3028, 0.0147}));
+            mutators.push_back(std::make_unique<mutator::DeletionEvents>(10 * 0.0005695,
+                std::vector<float>{0.2468, 0.2362, 0.2669, 0.2500},
+                std::vector<float>{0.8602, 0.0612, 0.0178, 0.0111, 0.0083, 0.0072, 0.0062, 0.0054, 0.0048, 0.0041, 0.0037, 0.0030, 0.0023, 0.0020, 0.0016, 0.0010}));
+            return mutators;
+        }},
+    };
+
+    bool ok = true;
+    for (Scenario const &scenario : scenarios) {
+        ok = check(scenario, n_sequences, n_copies) && ok;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,177 @@
+// check of the insertion and deletion mutators on 60, 150 and 1000 nt oligos at the photolithography rates and at four
+// times these rates, checking that they result in the same oligos as a reference applying the same events one by one, 
+// and that they change the length of the oligos by the expected number of bases
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "constants.hpp"
+#include "mutator.hpp"
+#include "rng.hpp"
+#include "sampler.hpp"
+
+
+// rates and biases of the insertions and deletions of the photolithographic synthesis
+const float INSERTION_RATE = 0.0136;
+const std::vector<float> INSERTION_BIAS = {0.25, 0.25, 0.25, 0.25};
+const std::vector<float> INSERTION_LENGTHS = {0.9275, 0.0453, 0.0126, 0.0146};
+const float DELETION_RATE = 0.0683;
+const std::vector<float> DELETION_BIAS = {0.25, 0.25, 0.25, 0.25};
+const std::vector<float> DELETION_LENGTHS = {0.8556, 0.1026, 0.0227, 0.0191};
+
+
+// random design sequence of the given length
+std::vector<char> random_sequence(size_t length) {
+    const char bases[4] = {constants::NUCLEOTIDE_A, constants::NUCLEOTIDE_C, constants::NUCLEOTIDE_G, constants::NUCLEOTIDE_T};
+    std::vector<char> sequence(length);
+    for (char &base : sequence) {
+        base = bases[rng::random_int(0, 3)];
+    }
+    return sequence;
+}
+
+
+// mean number of bases of an event with the given length distribution, whose first entry is one base
+double mean_event_length(std::vector<float> const &p_event_lengths) {
+    double total = 0.0, mean = 0.0;
+    for (size_t i = 0; i < p_event_lengths.size(); i++) {
+        total += p_event_lengths[i];
+        mean += (i + 1) * p_event_lengths[i];
+    }
+    return mean / total;
+}
+
+
+// reference of the insertions, applied one by one from the back, with the events, their lengths and their bases drawn in
+// the same order as by the mutator, such that both result in the same oligos
+void insert_one_by_one(mutator::BaseMutator &events, std::vector<char> &oligo, float rate, sampler::AliasSampler const &lengths, sampler::AliasSampler const &bases) {
+    arena::vector<int> positions = events.get_event_positions(oligo.size(), rate);
+    if (positions.empty()) {
+        return;
+    }
+    arena::vector<int> event_lengths(positions.size(), 0, arena::resource());
+    events.draw_from_distribution(event_lengths, lengths);
+    int n_bases = 0;
+    for (int &length : event_lengths) {
+        length += 1;
+        n_bases += length;
+    }
+    arena::vector<char> new_bases(n_bases, 0, arena::resource());
+    events.draw_from_distribution(new_bases, bases);
+    for (char &base : new_bases) {
+        base += 1;
+    }
+    size_t offset = 0;
+    for (size_t i = positions.size(); i-- > 0;) {
+        oligo.insert(oligo.begin() + positions[i] + 1, new_bases.begin() + offset, new_bases.begin() + offset + event_lengths[i]);
+        offset += event_lengths[i];
+    }
+}
+
+
+// reference of the deletions, applied one by one from the back, drawn in the same order as by the mutator
+void delete_one_by_one(mutator::BaseMutator &events, std::vector<char> &oligo, std::vector<float> const &p_event_by_base, sampler::AliasSampler const &lengths) {
+    arena::vector<int> positions = events.get_event_positions(oligo, p_event_by_base);
+    if (positions.empty()) {
+        return;
+    }
+    arena::vector<int> event_lengths(positions.size(), 0, arena::resource());
+    events.draw_from_distribution(event_lengths, lengths);
+    for (size_t i = positions.size(); i-- > 0;) {
+        size_t end = std::min((size_t)positions[i] + 1 + event_lengths[i], oligo.size());
+        oligo.erase(oligo.begin() + positions[i], oligo.begin() + end);
+    }
+}
+
+
+// mean and standard deviation of the length change of n_oligos copies of the sequence, and a checksum of the resulting
+// oligos
+struct Result {
+    double mean_change;
+    double sd_change;
+    uint64_t checksum;
+};
+
+template <typename Process>
+Result process_oligos(std::vector<char> const &sequence, size_t n_oligos, Process process) {
+    static std::vector<char> oligo;
+    double sum = 0.0, sum_squares = 0.0;
+    uint64_t checksum = 0;
+    rng::set_substream(0, sequence.size());
+    for (size_t i = 0; i < n_oligos; i++) {
+        arena::resource()->reset();
+        oligo.assign(sequence.begin(), sequence.end());
+        process(oligo);
+        double change = (double)oligo.size() - (double)sequence.size();
+        sum += change;
+        sum_squares += change * change;
+        for (char base : oligo) {
+            checksum = checksum * 31 + base;
+        }
+    }
+    double mean = sum / n_oligos;
+    return {mean, std::sqrt(std::max(sum_squares / n_oligos - mean * mean, 0.0)), checksum};
+}
+
+
+// compare the mutator to the reference for one kind of event, and check the mean length change of the mutator
+bool compare(const char *name, size_t length, float scale, size_t n_oligos, double expected_change, Result mutator, Result reference) {
+    printf("%-10s %5zu nt, %gx rate: %zu oligos, mean length change %+.3f (expected %+.3f)\n",
+        name, length, scale, n_oligos, mutator.mean_change, expected_change);
+
+    if (mutator.checksum != reference.checksum) {
+        printf("%s resulted in other %zu nt oligos than applying the same events one by one\n", name, length);
+        return false;
+    }
+
+    // deletions reaching past the end of an oligo delete fewer bases, which is allowed for as 1% of the expected change
+    double tolerance = 5 * mutator.sd_change / std::sqrt((double)n_oligos) + 0.01 * std::abs(expected_change);
+    if (std::abs(mutator.mean_change - expected_change) > tolerance) {
+        printf("%s changed the length of %zu nt oligos by %f bases instead of %f\n", name, length, mutator.mean_change, expected_change);
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_bases = argc > 1 ? std::stoull(argv[1]) : 6000000;
+
+    sampler::AliasSampler insertion_bases(INSERTION_BIAS.begin(), INSERTION_BIAS.end());
+    sampler::AliasSampler insertion_lengths(INSERTION_LENGTHS.begin(), INSERTION_LENGTHS.end());
+    sampler::AliasSampler deletion_lengths(DELETION_LENGTHS.begin(), DELETION_LENGTHS.end());
+
+    bool ok = true;
+    for (float scale : {1.0f, 4.0f}) {
+        float insertion_rate = scale * INSERTION_RATE;
+        float deletion_rate = scale * DELETION_RATE;
+        mutator::InsertionEvents insertions(insertion_rate, INSERTION_BIAS, INSERTION_LENGTHS);
+        mutator::DeletionEvents deletions(deletion_rate, DELETION_BIAS, DELETION_LENGTHS);
+        std::vector<float> p_deletion_by_base(4, deletion_rate);
+
+        for (size_t length : {60, 150, 1000}) {
+            rng::set_substream(0, 0);
+            std::vector<char> sequence = random_sequence(length);
+            size_t n_oligos = n_bases / length;
+
+            Result inserted = process_oligos(sequence, n_oligos, [&](std::vector<char> &oligo) { insertions.process(oligo); });
+            Result inserted_one_by_one = process_oligos(sequence, n_oligos,
+                [&](std::vector<char> &oligo) { insert_one_by_one(insertions, oligo, insertion_rate, insertion_lengths, insertion_bases); });
+            double expected = length * insertion_rate * mean_event_length(INSERTION_LENGTHS);
+            ok = compare("insertions", length, scale, n_oligos, expected, inserted, inserted_one_by_one) && ok;
+
+            Result deleted = process_oligos(sequence, n_oligos, [&](std::vector<char> &oligo) { deletions.process(oligo); });
+            Result deleted_one_by_one = process_oligos(sequence, n_oligos,
+                [&](std::vector<char> &oligo) { delete_one_by_one(deletions, oligo, p_deletion_by_base, deletion_lengths); });
+            expected = -(double)length * deletion_rate * mean_event_length(DELETION_LENGTHS);
+            ok = compare("deletions", length, scale, n_oligos, expected, deleted, deleted_one_by_one) && ok;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+// check of merging the reads of the tasks of a sequence whose copies are spread over several tasks, some of which have
+// already been collapsed into unique reads with multiplicities while others hold each read once, checking that the
+// merged reads keep the number of times each read occurs
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "fileio.hpp"
+#include "oligocollector.hpp"
+
+
+// reads of a task from the given sequences, collapsed with their multiplicities if any are given
+oligocollector::CollectedReads make_reads(std::vector<std::string> const &sequences, std::vector<unsigned int> const &multiplicities) {
+    oligocollector::CollectedReads reads;
+    for (std::string const &sequence : sequences) {
+        std::vector<char> oligo;
+        for (char base : sequence) {
+            oligo.push_back(base == 'A' ? constants::NUCLEOTIDE_A : base == 'C' ? constants::NUCLEOTIDE_C : base == 'G' ? constants::NUCLEOTIDE_G : constants::NUCLEOTIDE_T);
+        }
+        reads.fw.push_back(oligo);
+    }
+    reads.multiplicities = multiplicities;
+    return reads;
+}
+
+
+// number of times each read occurs in the given tasks
+std::map<std::string, unsigned int> count_reads(std::vector<oligocollector::CollectedReads> const &tasks) {
+    std::map<std::string, unsigned int> counts;
+    for (oligocollector::CollectedReads const &reads : tasks) {
+        bool weighted = reads.multiplicities.size() == reads.fw.size();
+        for (size_t i = 0; i < reads.fw.size(); i++) {
+            counts[std::string(reads.fw.view(i))] += weighted ? reads.multiplicities[i] : 1;
+        }
+    }
+    return counts;
+}
+
+
+// merge the tasks and compare the occurrences of each read before and after
+bool check_merge(const char *name, oligocollector::OligoCollector &collector, std::vector<oligocollector::CollectedReads> tasks) {
+    std::map<std::string, unsigned int> expected = count_reads(tasks);
+    collector.merge_reads(tasks);
+    std::map<std::string, unsigned int> merged = count_reads(tasks);
+
+    bool ok = merged == expected && tasks[0].multiplicities.size() == tasks[0].fw.size() && tasks[0].fw.size() == expected.size();
+    for (size_t i = 1; i < tasks.size(); i++) {
+        ok = ok && tasks[i].fw.empty();
+    }
+    printf("%-32s %zu tasks into %zu unique reads: %s\n", name, tasks.size(), tasks[0].fw.size(), ok ? "ok" : "counts differ");
+    return ok;
+}
+
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    fileio::SequenceFileWriter writer((directory / "bench_merge_reads.bin").string(), fileio::WriteFileType::BINARY);
+    oligocollector::OligoCollector collector(writer);
+    collector.set_collapse_duplicates(true);
+
+    oligocollector::CollectedReads weighted = make_reads({"ACGT", "GGCC", "TTAA"}, {5, 3, 2});
+    oligocollector::CollectedReads unweighted = make_reads({"ACGT", "CCCC", "ACGT"}, {});
+
+    bool ok = check_merge("weighted, then unweighted", collector, {weighted, unweighted});
+    ok = check_merge("unweighted, then weighted", collector, {unweighted, weighted}) && ok;
+    ok = check_merge("weighted, unweighted, weighted", collector, {weighted, unweighted, weighted}) && ok;
+    ok = check_merge("unweighted only", collector, {unweighted, unweighted}) && ok;
+
+    collector.finish();
+    writer.remove();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
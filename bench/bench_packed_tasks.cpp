@@ -0,0 +1,165 @@
+// check that the reads of each design sequence only depend on its own substreams, running the pipeline over many
+// sequences with few copies, which are packed several at a time into the same task, and regenerating the reads of each
+// sequence on its own by jumping straight to its substreams, which must give the same reads as the full run
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arena.hpp"
+#include "constants.hpp"
+#include "fileio.hpp"
+#include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "oligocollector.hpp"
+#include "oligofactory.hpp"
+#include "pipeline.hpp"
+#include "rng.hpp"
+#include "scenarios.hpp"
+
+
+// random design sequences of random lengths, each with a random number of copies, mostly few enough to be packed
+void random_design(size_t n_sequences, std::vector<std::vector<char>> &sequences, std::vector<unsigned int> &oligo_counts) {
+    const char bases[4] = {constants::NUCLEOTIDE_A, constants::NUCLEOTIDE_C, constants::NUCLEOTIDE_G, constants::NUCLEOTIDE_T};
+    rng::set_substream(0, 0);
+    sequences.assign(n_sequences, {});
+    oligo_counts.assign(n_sequences, 0);
+    for (size_t i = 0; i < n_sequences; i++) {
+        sequences[i].resize(rng::random_int(60, 150));
+        for (char &base : sequences[i]) {
+            base = bases[rng::random_int(0, 3)];
+        }
+        oligo_counts[i] = (i % 50 == 49) ? 3 * constants::COPIES_PER_TASK : rng::random_int(0, 40);
+    }
+}
+
+
+// all reads of a file, one after another
+std::vector<std::vector<char>> read_file(std::string const &filename) {
+    fileio::SequenceFileReader reader(filename);
+    std::vector<std::vector<char>> reads;
+    std::vector<char> read;
+    while (reader.get_sequence(read)) {
+        reads.push_back(read);
+    }
+    return reads;
+}
+
+
+// regenerate the reads of a single sequence from its substreams, with its copies split into tasks as in the pipeline
+void regenerate_sequence(
+    oligocollector::OligoCollector &collector,
+    std::vector<char> const &sequence,
+    size_t i_seq,
+    unsigned int n_oligos,
+    std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators,
+    std::vector<std::vector<char>> &reads_fw,
+    std::vector<std::vector<char>> &reads_rv
+    ) {
+    oligobatch::OligoBatch oligos;
+    oligocollector::CollectedReads reads;
+    std::vector<char> read;
+    unsigned int copies_per_task = n_oligos <= constants::COPIES_PER_TASK ? n_oligos : constants::COPIES_PER_TASK;
+    for (unsigned int first_copy = 0; first_copy < n_oligos; first_copy += copies_per_task) {
+        oligos.clear();
+        rng::set_substream(constants::RNG_STREAM_SEQUENCING, i_seq);
+        arena::resource()->reset();
+        oligofactory::generate_oligos(oligos, sequence, std::min(n_oligos - first_copy, copies_per_task), mutators, first_copy);
+
+        arena::resource()->reset();
+        rng::set_substream(constants::RNG_STREAM_READS, i_seq, first_copy + 1);
+        collector.prepare_reads(oligos, reads);
+        for (size_t i = 0; i < reads.fw.size(); i++) {
+            reads.fw.get(i, read);
+            reads_fw.push_back(read);
+        }
+        for (size_t i = 0; i < reads.rv.size(); i++) {
+            reads.rv.get(i, read);
+            reads_rv.push_back(read);
+        }
+    }
+}
+
+
+// run the recovery and sequencing of a challenge over all sequences, and compare the reads to those of each sequence
+// regenerated on its own
+template <typename Scenario>
+bool check_challenge(const char *name, Scenario scenario, std::vector<std::vector<char>> const &sequences, std::vector<unsigned int> const &oligo_counts, int n_threads) {
+    float initial_coverage_bias, mean_physical_coverage, mean_sequencing_coverage;
+    int read_length;
+    std::vector<std::unique_ptr<mutator::BaseMutator>> initial_mutators, recovery_mutators, sequencing_mutators, single_mutators;
+    scenario(initial_coverage_bias, mean_physical_coverage, mean_sequencing_coverage, read_length, initial_mutators, recovery_mutators);
+    scenarios::sequencing(true, true, read_length, sequencing_mutators);
+    scenarios::sequencing(true, true, read_length, single_mutators);
+
+    // the full run, reading the design sequences from a file
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string input = (directory / "bench_packed_tasks.txt").string();
+    std::string output_fw = (directory / "bench_packed_tasks.1").string();
+    std::string output_rv = (directory / "bench_packed_tasks.2").string();
+    {
+        fileio::SequenceFileWriter writer(input);
+        for (std::vector<char> const &sequence : sequences) {
+            writer.write_sequence_vector(sequence);
+        }
+    }
+    {
+        fileio::SequenceFileReader reader(input);
+        fileio::SequenceFileWriter writer_fw(output_fw);
+        fileio::SequenceFileWriter writer_rv(output_rv);
+        oligocollector::OligoCollector collector(writer_fw, writer_rv);
+        collector.set_mutators(sequencing_mutators);
+        pipeline::process(reader, collector, oligo_counts, recovery_mutators, n_threads, constants::RNG_STREAM_SEQUENCING);
+    }
+    std::vector<std::vector<char>> full_fw = read_file(output_fw);
+    std::vector<std::vector<char>> full_rv = read_file(output_rv);
+
+    // each sequence on its own, the collector is only used to prepare the reads
+    std::vector<std::vector<char>> single_fw, single_rv;
+    {
+        fileio::SequenceFileWriter writer_fw((directory / "bench_packed_tasks.single.1").string());
+        fileio::SequenceFileWriter writer_rv((directory / "bench_packed_tasks.single.2").string());
+        oligocollector::OligoCollector collector(writer_fw, writer_rv);
+        collector.set_mutators(single_mutators);
+        for (size_t i = 0; i < sequences.size(); i++) {
+            regenerate_sequence(collector, sequences[i], i, oligo_counts[i], recovery_mutators, single_fw, single_rv);
+        }
+        collector.finish();
+        writer_fw.remove();
+        writer_rv.remove();
+    }
+    std::filesystem::remove(input);
+    std::filesystem::remove(output_fw);
+    std::filesystem::remove(output_rv);
+
+    // find the first read that differs
+    size_t n_same = 0;
+    while (n_same < full_fw.size() && n_same < single_fw.size() && full_fw[n_same] == single_fw[n_same] && n_same < full_rv.size() && n_same < single_rv.size() && full_rv[n_same] == single_rv[n_same]) {
+        n_same++;
+    }
+    bool ok = full_fw.size() == single_fw.size() && full_rv.size() == single_rv.size() && n_same == full_fw.size();
+    printf("%-18s %zu sequences on %d threads, %zu reads, %zu reads of the sequences on their own: %s\n", name, sequences.size(),
+        n_threads, full_fw.size(), single_fw.size(), ok ? "same" : ("differ from read #" + std::to_string(n_same)).c_str());
+    return ok;
+}
+
+
+int main(int argc, char **argv) {
+    size_t n_sequences = argc > 1 ? std::stoull(argv[1]) : 2000;
+    std::vector<std::vector<char>> sequences;
+    std::vector<unsigned int> oligo_counts;
+    random_design(n_sequences, sequences, oligo_counts);
+
+    bool ok = true;
+    for (int n_threads : {1, 3}) {
+        ok = check_challenge("decay", scenarios::challenge_decay, sequences, oligo_counts, n_threads) && ok;
+        ok = check_challenge("photolithography", scenarios::challenge_photolithography, sequences, oligo_counts, n_threads) && ok;
+    }
+    if (!ok) {
+        printf("the reads of a sequence depend on the other sequences of its task\n");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
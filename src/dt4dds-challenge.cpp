@@ -62,6 +62,11 @@ int main(int argc, char *argv[]) {
     program.add_argument("-i", "--intermediate_file")
     .help("path to the intermediate file, default will create temporary file");
 
+    program.add_argument("-t", "--threads")
+    .help("number of worker threads used to generate the oligos and reads")
+    .default_value(1)
+    .scan<'d', int>();
+
     program.add_argument("-f", "--format")
     .help("format of the output file (txt, fasta, fastq)")
     .choices("txt", "fasta", "fastq")
@@ -85,7 +90,7 @@ int main(int argc, char *argv[]) {
 
     program.add_argument("--seed")
     .help("seed for the random number generator, default is to use the current time")
-    .scan<'d', int>();
+    .scan<'u', unsigned long long>();
 
     program.add_argument("--no_adapter")
     .help("disable the adapter sequences in the output files")
@@ -162,7 +167,7 @@ int main(int argc, char *argv[]) {
             read_length = *fn;
             logger.warning("Read length changed from default to {}", read_length);
         }
-        if (auto fn = program.present<int>("--seed")) {
+        if (auto fn = program.present<unsigned long long>("--seed")) {
             rng::seed_rng(*fn);
             logger.warning("Used custom seed {}", *fn);
         }
@@ -198,6 +203,16 @@ int main(int argc, char *argv[]) {
         write_file_type = fileio::WriteFileType::FASTQ;
     }
 
+    // get the number of worker threads, results do not depend on it
+    int n_threads = program.get<int>("--threads");
+    if (n_threads < 1) {
+        logger.critical("Number of threads must be at least 1, got {}", n_threads);
+        return 1;
+    }
+    if (n_threads > 1) {
+        logger.info("Using {} worker threads", n_threads);
+    }
+
     // get the intermediate file's handle
     std::string intermediate_filename = std::tmpnam(nullptr);
     if (auto fn = program.present("--intermediate_file")) {
@@ -217,7 +232,8 @@ int main(int argc, char *argv[]) {
         initial_mutators,
         recovery_mutators,
         sequencing_mutators,
-        write_file_type
+        write_file_type,
+        n_threads
     );
 
     // log the end of the process and the duration it took
@@ -0,0 +1,57 @@
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "arena.hpp"
+#include "constants.hpp"
+
+
+namespace arena {
+
+    static std::atomic<uint64_t> _heap_allocations = 0;
+
+
+    // allocate from the current block, or move on to the next block that is large enough
+    void* Arena::do_allocate(size_t bytes, size_t alignment) {
+        while (true) {
+            // add a new block once all blocks are used, at least twice as large as the previous one
+            if (_block == _blocks.size()) {
+                size_t size = std::max(bytes + alignment, constants::ARENA_BLOCK_SIZE);
+                if (!_blocks.empty()) {
+                    size = std::max(size, 2 * _blocks.back().size);
+                }
+                _blocks.push_back({std::make_unique<std::byte[]>(size), size});
+                _heap_allocations++;
+            }
+
+            // align the start of the allocation within the block
+            uintptr_t base = (uintptr_t)_blocks[_block].data.get();
+            size_t start = ((base + _used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+            if (start + bytes <= _blocks[_block].size) {
+                _used = start + bytes;
+                return _blocks[_block].data.get() + start;
+            }
+            _block++;
+            _used = 0;
+        }
+    }
+
+    // release all memory allocated since the last reset, which must not be in use anymore
+    void Arena::reset() {
+        _block = 0;
+        _used = 0;
+    }
+
+
+    // the arena of the calling thread
+    Arena* resource() {
+        static thread_local Arena arena;
+        return &arena;
+    }
+
+    // number of blocks the arenas of all threads have allocated from the heap
+    uint64_t count_heap_allocations() {
+        return _heap_allocations;
+    }
+
+} // namespace arena
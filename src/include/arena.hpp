@@ -0,0 +1,51 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace arena {
+
+    // bump allocator for the scratch memory of a single thread, whose memory is released at once by reset()
+    // the blocks are kept for reuse, such that only a growing demand allocates from the heap
+    class Arena : public std::pmr::memory_resource {
+        private:
+            struct Block {
+                std::unique_ptr<std::byte[]> data;
+                size_t size;
+            };
+            std::vector<Block> _blocks;
+            size_t _block = 0; // block currently allocated from
+            size_t _used = 0; // bytes used in the current block
+
+            void* do_allocate(size_t bytes, size_t alignment) override;
+            void do_deallocate(void*, size_t, size_t) override {}
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+        public:
+            Arena() = default;
+            Arena(const Arena&) = delete;
+            Arena& operator=(const Arena&) = delete;
+
+            // release all memory allocated since the last reset, which must not be in use anymore
+            void reset();
+    };
+
+    // vector with its memory in an arena
+    template <typename T>
+    using vector = std::pmr::vector<T>;
+
+    // the arena of the calling thread
+    Arena* resource();
+
+    // number of blocks the arenas of all threads have allocated from the heap
+    uint64_t count_heap_allocations();
+
+} // namespace arena
+
+
+#endif // ARENA_HPP
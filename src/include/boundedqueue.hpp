@@ -0,0 +1,87 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <utility>
+
+namespace boundedqueue {
+
+    // lock-free ring buffer for a single producer and a single consumer
+    // the producer blocks while the queue is full, which applies backpressure on it,
+    // and the consumer blocks while the queue is empty until the queue is closed
+    // items are swapped in and out of the slots, such that the buffers of popped items return to the producer
+    template <typename T>
+    class BoundedQueue {
+        private:
+            std::vector<T> _buffer;
+            size_t _capacity;
+            alignas(64) std::atomic<size_t> _head = 0; // next slot to pop, owned by the consumer
+            alignas(64) std::atomic<size_t> _tail = 0; // next slot to push, owned by the producer
+            alignas(64) std::atomic<unsigned int> _pushed_signal = 0;
+            alignas(64) std::atomic<unsigned int> _popped_signal = 0;
+            std::atomic<bool> _closed = false;
+            double _blocked_seconds = 0.0;
+
+        public:
+            BoundedQueue(size_t capacity) : _buffer(capacity), _capacity(capacity) {}
+
+            // move an item into the queue, blocking while the queue is full
+            // the item is left with a previously popped item, whose buffers can be reused
+            void push(T& item) {
+                size_t tail = _tail.load(std::memory_order_relaxed);
+                if (tail - _head.load(std::memory_order_acquire) >= _capacity) {
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    while (true) {
+                        unsigned int signal = _popped_signal.load(std::memory_order_acquire);
+                        if (tail - _head.load(std::memory_order_acquire) < _capacity) {
+                            break;
+                        }
+                        _popped_signal.wait(signal, std::memory_order_acquire);
+                    }
+                    _blocked_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                }
+                std::swap(_buffer[tail % _capacity], item);
+                _tail.store(tail + 1, std::memory_order_release);
+                _pushed_signal.fetch_add(1, std::memory_order_release);
+                _pushed_signal.notify_one();
+            }
+
+            // move the next item out of the queue, blocking while the queue is empty
+            // the previous contents of the item are left in the queue for reuse by the producer
+            // returns false once the queue is closed and empty
+            bool pop(T& item) {
+                size_t head = _head.load(std::memory_order_relaxed);
+                while (true) {
+                    unsigned int signal = _pushed_signal.load(std::memory_order_acquire);
+                    if (_tail.load(std::memory_order_acquire) != head) {
+                        break;
+                    }
+                    if (_closed.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                    _pushed_signal.wait(signal, std::memory_order_acquire);
+                }
+                std::swap(item, _buffer[head % _capacity]);
+                _head.store(head + 1, std::memory_order_release);
+                _popped_signal.fetch_add(1, std::memory_order_release);
+                _popped_signal.notify_one();
+                return true;
+            }
+
+            // signal the consumer that no more items will be pushed
+            void close() {
+                _closed.store(true, std::memory_order_release);
+                _pushed_signal.fetch_add(1, std::memory_order_release);
+                _pushed_signal.notify_one();
+            }
+
+            // time the producer spent waiting for free slots
+            double get_blocked_seconds() const { return _blocked_seconds; }
+    };
+
+} // namespace boundedqueue
+
+
+#endif // BOUNDEDQUEUE_HPP
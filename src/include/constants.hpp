@@ -1,14 +1,30 @@
 #ifndef CONSTANTS_HPP
 #define CONSTANTS_HPP
 
+#include <cstddef>
+
 namespace constants {
     inline constexpr char NUCLEOTIDE_A = 1; // integer representation of nucleotide A
     inline constexpr char NUCLEOTIDE_C = 2; // integer representation of nucleotide C
     inline constexpr char NUCLEOTIDE_G = 3; // integer representation of nucleotide G
     inline constexpr char NUCLEOTIDE_T = 4; // integer representation of nucleotide T
-    inline constexpr char NUCLEOTIDE_NEXTOLIGO = 127; // flag to indicate the next oligo in a binary sequence file
+    inline constexpr char BINARY_FILE_MAGIC[8] = {'D', 'T', '4', 'D', 'D', 'S', 'B', '2'}; // start of the header of a binary sequence file
     
     inline constexpr int DEFAULT_SEQUENCE_LENGTH { 500 }; // default length of a sequence for vector allocation
+    inline constexpr int SEQUENCES_PER_THREAD_CHUNK { 64 }; // number of sequences per thread handed to the workers at once
+    inline constexpr unsigned int COPIES_PER_TASK { 64 }; // number of copies of a sequence generated by a single worker task
+    inline constexpr unsigned int OLIGOS_PER_TASK { 512 }; // number of oligos of several sequences with few copies generated by a single worker task
+    inline constexpr int WRITER_QUEUE_CAPACITY { 64 }; // number of read batches that can wait for each writer thread
+    inline constexpr size_t WRITER_BATCH_KEEP_BASES { 32768 }; // maximum number of bases a written batch keeps space for when it is reused
+    inline constexpr size_t COVERAGE_BLOCK_SIZE { 65536 }; // number of sequences per block when sampling the coverage
+    inline constexpr size_t ARENA_BLOCK_SIZE { 65536 }; // minimum size in bytes of a block of the scratch memory of a thread
+    inline constexpr size_t SEGMENT_CHUNK_SIZE { 16 }; // number of bases copied at once when assembling an oligo from segments
+
+    inline constexpr unsigned int RNG_STREAM_SYNTHESIS = 1; // random number substream for synthesis and sampling
+    inline constexpr unsigned int RNG_STREAM_SEQUENCING = 2; // random number substream for recovery and sequencing
+    inline constexpr unsigned int RNG_STREAM_COVERAGE = 3; // random number substream for the coverage distributions
+    inline constexpr unsigned int RNG_STREAM_READS = 4; // random number substream for the mutations of the reads
+    inline constexpr unsigned int RNG_COPY_AGGREGATE = 0x80000000; // flag on the copy index for draws over all copies of a task
 }
 
 #endif // CONSTANTS_HPP
\ No newline at end of file
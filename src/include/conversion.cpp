@@ -1,6 +1,13 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "conversion.hpp"
 #include "constants.hpp"
@@ -10,6 +17,27 @@ static Logger logger("conversion", "INFO");
 
 namespace conversion {
 
+    // lookup table from characters to integers, with 0 for invalid characters
+    static constexpr std::array<char, 256> _nucleotide_table = [] {
+        std::array<char, 256> table{};
+        table['A'] = constants::NUCLEOTIDE_A;
+        table['C'] = constants::NUCLEOTIDE_C;
+        table['G'] = constants::NUCLEOTIDE_G;
+        table['T'] = constants::NUCLEOTIDE_T;
+        return table;
+    }();
+
+    // lookup table from packed bytes to their four integers, in memory order
+    static constexpr std::array<std::array<char, 4>, 256> _unpack_table = [] {
+        std::array<std::array<char, 4>, 256> table{};
+        for (int byte = 0; byte < 256; byte++) {
+            for (int i = 0; i < 4; i++) {
+                table[byte][i] = constants::NUCLEOTIDE_A + ((byte >> (2 * i)) & 3);
+            }
+        }
+        return table;
+    }();
+
     // function to convert a sequence to a vector of integers
     void sequence_to_vector(const std::string& sequence, std::vector<char>& sequence_vector) {
         // clear the sequence vector
@@ -38,14 +66,97 @@ namespace conversion {
     }
 
 
+    // function to validate the characters in [begin, end) and append them to the vector as integers
+    bool append_sequence(const char* begin, const char* end, std::vector<char>& sequence_vector) {
+        size_t offset = sequence_vector.size();
+        sequence_vector.resize(offset + (end - begin));
+        char* out = sequence_vector.data() + offset;
+        const char* in = begin;
+
+#ifdef __SSE2__
+        // validate and convert 16 characters at once, each integer is set from the mask of its nucleotide
+        const __m128i char_a = _mm_set1_epi8('A'), char_c = _mm_set1_epi8('C'), char_g = _mm_set1_epi8('G'), char_t = _mm_set1_epi8('T');
+        const __m128i code_a = _mm_set1_epi8(constants::NUCLEOTIDE_A), code_c = _mm_set1_epi8(constants::NUCLEOTIDE_C);
+        const __m128i code_g = _mm_set1_epi8(constants::NUCLEOTIDE_G), code_t = _mm_set1_epi8(constants::NUCLEOTIDE_T);
+        for (; end - in >= 16; in += 16, out += 16) {
+            __m128i chars = _mm_loadu_si128((const __m128i*)in);
+            __m128i is_a = _mm_cmpeq_epi8(chars, char_a);
+            __m128i is_c = _mm_cmpeq_epi8(chars, char_c);
+            __m128i is_g = _mm_cmpeq_epi8(chars, char_g);
+            __m128i is_t = _mm_cmpeq_epi8(chars, char_t);
+            __m128i is_valid = _mm_or_si128(_mm_or_si128(is_a, is_c), _mm_or_si128(is_g, is_t));
+            if (_mm_movemask_epi8(is_valid) != 0xFFFF) {
+                return false;
+            }
+            __m128i codes = _mm_or_si128(
+                _mm_or_si128(_mm_and_si128(is_a, code_a), _mm_and_si128(is_c, code_c)),
+                _mm_or_si128(_mm_and_si128(is_g, code_g), _mm_and_si128(is_t, code_t))
+            );
+            _mm_storeu_si128((__m128i*)out, codes);
+        }
+#endif
+
+        // convert the remaining characters one by one
+        for (; in < end; in++, out++) {
+            char code = _nucleotide_table[(unsigned char)*in];
+            if (code == 0) {
+                return false;
+            }
+            *out = code;
+        }
+        return true;
+    }
+
+
+    // function to pack the integers of a sequence with 2 bits each, four per byte
+    bool pack_sequence(const char* sequence, size_t length, char* packed) {
+        // the integers are consecutive from A, such that the bits of each base are its offset from A
+        unsigned char invalid = 0;
+        size_t i = 0;
+        for (; i + 4 <= length; i += 4) {
+            unsigned char b0 = sequence[i] - constants::NUCLEOTIDE_A;
+            unsigned char b1 = sequence[i + 1] - constants::NUCLEOTIDE_A;
+            unsigned char b2 = sequence[i + 2] - constants::NUCLEOTIDE_A;
+            unsigned char b3 = sequence[i + 3] - constants::NUCLEOTIDE_A;
+            invalid |= b0 | b1 | b2 | b3;
+            packed[i / 4] = b0 | (b1 << 2) | (b2 << 4) | (b3 << 6);
+        }
+        if (i < length) {
+            unsigned char byte = 0;
+            for (size_t j = 0; i + j < length; j++) {
+                unsigned char base = sequence[i + j] - constants::NUCLEOTIDE_A;
+                invalid |= base;
+                byte |= base << (2 * j);
+            }
+            packed[i / 4] = byte;
+        }
+        return (invalid & ~3) == 0;
+    }
+
+
+    // function to unpack a sequence of the given length from its packed integers
+    void unpack_sequence(const char* packed, size_t length, char* sequence) {
+        size_t n_full = length / 4;
+        for (size_t i = 0; i < n_full; i++) {
+            std::memcpy(sequence + 4 * i, _unpack_table[(unsigned char)packed[i]].data(), 4);
+        }
+        if (length % 4 != 0) {
+            std::memcpy(sequence + 4 * n_full, _unpack_table[(unsigned char)packed[n_full]].data(), length % 4);
+        }
+    }
+
+
     // function to convert a vector of integers to a sequence
     std::string vector_to_sequence(const std::vector<char>& sequence_vector) {
+        return vector_to_sequence(sequence_vector.data(), sequence_vector.size());
+    }
+    std::string vector_to_sequence(const char* sequence_vector, size_t length) {
         // create a string to hold the sequence
         std::string sequence;
-        sequence.reserve(sequence_vector.size());
+        sequence.reserve(length);
 
         // iterate over the sequence and convert the integers to characters
-        for (int i = 0; i < sequence_vector.size(); i++) {
+        for (size_t i = 0; i < length; i++) {
             switch (sequence_vector[i]) {
                 case constants::NUCLEOTIDE_A:
                     sequence.push_back('A');
@@ -70,31 +181,44 @@ namespace conversion {
 
     // function to convert a vector sequence to its reverse complement
     std::vector<char> reverse_complement(const std::vector<char>& sequence_vector) {
-        // create a vector to hold the reverse complement
-        std::vector<char> reverse_complement_vector;
-        reverse_complement_vector.reserve(sequence_vector.size());
+        std::vector<char> reverse_complement_vector(sequence_vector);
+        reverse_complement_in_place(reverse_complement_vector.data(), reverse_complement_vector.size());
+        return reverse_complement_vector;
+    }
 
-        // iterate over the sequence and convert the characters to integers
-        for (int i = sequence_vector.size() - 1; i >= 0; i--) {
-            switch (sequence_vector[i]) {
-                case constants::NUCLEOTIDE_A:
-                    reverse_complement_vector.push_back(constants::NUCLEOTIDE_T);
-                    break;
-                case constants::NUCLEOTIDE_C:
-                    reverse_complement_vector.push_back(constants::NUCLEOTIDE_G);
-                    break;
-                case constants::NUCLEOTIDE_G:
-                    reverse_complement_vector.push_back(constants::NUCLEOTIDE_C);
-                    break;
-                case constants::NUCLEOTIDE_T:
-                    reverse_complement_vector.push_back(constants::NUCLEOTIDE_A);
-                    break;
-                default:
-                    logger.critical("Invalid character in sequence: {}", sequence_vector[i]);
-                    throw std::runtime_error("Invalid character in sequence: " + sequence_vector[i]);
-            }
+
+    // the complement of a nucleotide, which mirrors it within the integers 1 to 4
+    static char complement(char base) {
+        if ((unsigned char)(base - constants::NUCLEOTIDE_A) > constants::NUCLEOTIDE_T - constants::NUCLEOTIDE_A) {
+            logger.critical("Invalid character in sequence: {}", (int)base);
+            throw std::runtime_error("Invalid character in sequence: " + std::to_string(base));
+        }
+        return (char)(constants::NUCLEOTIDE_A + constants::NUCLEOTIDE_T - base);
+    }
+
+
+    // function to replace a sequence by its reverse complement, by swapping the complements of the bases from both ends
+    void reverse_complement_in_place(char* sequence, size_t length) {
+        char* front = sequence;
+        char* back = sequence + length;
+        while (back - front > 1) {
+            back--;
+            char base = complement(*front);
+            *front = complement(*back);
+            *back = base;
+            front++;
+        }
+        if (front != back) {
+            *front = complement(*front);
+        }
+    }
+
+
+    // function to write the reverse complement of a sequence to a separate destination, reading the sequence backwards
+    void reverse_complement_copy(const char* sequence, size_t length, char* destination) {
+        for (size_t i = 0; i < length; i++) {
+            destination[i] = complement(sequence[length - 1 - i]);
         }
-        return reverse_complement_vector;
     }
 
 
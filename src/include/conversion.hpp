@@ -11,12 +11,29 @@ namespace conversion {
     // function to convert a sequence to a vector of integers
     void sequence_to_vector(const std::string& sequence, std::vector<char>& sequence_vector);
 
+    // function to validate the characters in [begin, end) and append them to the vector as integers,
+    // returns false if there is a character other than A, C, G and T
+    bool append_sequence(const char* begin, const char* end, std::vector<char>& sequence_vector);
+
+    // function to pack the integers of a sequence with 2 bits each, four per byte, returns false if there is an invalid integer
+    bool pack_sequence(const char* sequence, size_t length, char* packed);
+
+    // function to unpack a sequence of the given length from its packed integers
+    void unpack_sequence(const char* packed, size_t length, char* sequence);
+
     // function to convert a vector of integers to a sequence
     std::string vector_to_sequence(const std::vector<char>& sequence_vector);
+    std::string vector_to_sequence(const char* sequence_vector, size_t length);
 
     // function to convert a vector sequence to its reverse complement
     std::vector<char> reverse_complement(const std::vector<char>& sequence_vector);
 
+    // function to replace a sequence of the given length by its reverse complement
+    void reverse_complement_in_place(char* sequence, size_t length);
+
+    // function to write the reverse complement of a sequence of the given length to a separate destination
+    void reverse_complement_copy(const char* sequence, size_t length, char* destination);
+
 } 
 
 
@@ -2,17 +2,54 @@
 #include <stdexcept>
 #include <vector>
 #include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
 
 #include "coverage.hpp"
+#include "constants.hpp"
 #include "rng.hpp"
+#include "threadpool.hpp"
 #include "logging.hpp"
 
 static Logger logger("coverage", "INFO");
 
 namespace coverage {
 
-    // sample a specific number of oligos from a probability distribution with replacement
-    std::vector<unsigned int> _sample_from_relative_coverage(std::vector<float> const &relative_coverage, const int n_oligos) {
+    // distribute n_oligos over the entries [first, last) with probabilities proportional to their weights,
+    // by drawing the count of each entry from a binomial distribution conditioned on the preceding entries
+    template <typename Weight, typename Count>
+    void _sample_multinomial(std::vector<Weight> const &weights, size_t first, size_t last, uint64_t n_oligos, std::vector<Count> &counts, rng::Philox &generator) {
+        // get the weight remaining from each entry onwards, summed from the back to avoid cancellation
+        std::vector<double> remaining_weight(last - first + 1, 0.0);
+        for (size_t i = last; i > first; i--) {
+            remaining_weight[i - 1 - first] = remaining_weight[i - first] + weights[i - 1];
+        }
+
+        // draw the count of each entry from the oligos that are not yet assigned, the entries after the last one with 
+        // any weight are left at zero
+        uint64_t remaining_oligos = n_oligos;
+        for (size_t i = first; i < last && remaining_oligos > 0 && remaining_weight[i - first] > 0.0; i++) {
+            double p = weights[i] / remaining_weight[i - first];
+            uint64_t count = remaining_oligos;
+            if (p < 1.0) {
+                std::binomial_distribution<int64_t> binomial(remaining_oligos, p);
+                count = binomial(generator);
+            }
+            if (count > std::numeric_limits<Count>::max()) {
+                logger.critical("Sampled {} oligos for a single sequence, which exceeds the supported maximum.", count);
+                throw std::overflow_error("Sampled " + std::to_string(count) + " oligos for a single sequence, which exceeds the supported maximum.");
+            }
+            counts[i] = count;
+            remaining_oligos -= count;
+        }
+    }
+
+
+    // sample a specific number of oligos from a set of relative weights with replacement, as a single
+    // multinomial draw whose cost depends on the number of sequences instead of the number of oligos
+    template <typename Weight>
+    std::vector<unsigned int> _sample_from_weights(std::vector<Weight> const &weights, const uint64_t n_oligos, const int n_threads) {
         
         // check if the number of sampled oligos is less than 1
         if (n_oligos < 1) {
@@ -21,64 +58,85 @@ namespace coverage {
         }
 
         // check if there are sequences to sample from
-        if (relative_coverage.size() < 1) {
+        if (weights.size() < 1) {
             logger.critical("There are not sequences to sample from. Please check the input file and coverage settings.");
             throw std::invalid_argument("There are not sequences to sample from. Please check the input file and coverage settings.");
         }
 
-        // create a discrete distribution
-        std::discrete_distribution<> sampler(relative_coverage.begin(), relative_coverage.end());
+        // split the sequences into blocks and draw the number of oligos in each block on the current substream
+        const size_t n_sequences = weights.size();
+        const size_t n_blocks = (n_sequences + constants::COVERAGE_BLOCK_SIZE - 1) / constants::COVERAGE_BLOCK_SIZE;
+        std::vector<double> block_weights(n_blocks, 0.0);
+        for (size_t i = 0; i < n_sequences; i++) {
+            block_weights[i / constants::COVERAGE_BLOCK_SIZE] += weights[i];
+        }
+
+        // check if any sequence can be sampled
+        if (std::accumulate(block_weights.begin(), block_weights.end(), 0.0) <= 0.0) {
+            logger.critical("All sequences have a coverage of zero. Please check the input file and coverage settings.");
+            throw std::invalid_argument("All sequences have a coverage of zero. Please check the input file and coverage settings.");
+        }
 
-        // sample the distribution for n_oligos times
-        std::vector<unsigned int> sampled_coverage(relative_coverage.size(), 0);
-        for (int i = 0; i < n_oligos; i++) {
-            sampled_coverage[sampler(rng::rng)]++;
+        std::vector<uint64_t> block_oligos(n_blocks, 0);
+        _sample_multinomial(block_weights, 0, n_blocks, n_oligos, block_oligos, rng::rng);
+
+        // distribute the oligos of each block over its sequences, with a separate substream for each block drawn by a 
+        // generator of its own, such that the generator of the calling thread stays on its substream
+        std::vector<unsigned int> sampled_coverage(n_sequences, 0);
+        const uint32_t stream = rng::current_stream();
+        const uint64_t sequence = rng::current_sequence();
+        const rng::Philox caller_rng = rng::rng;
+        auto sample_block = [&](size_t i_block) {
+            rng::Philox block_rng = caller_rng;
+            block_rng.set_substream(stream, sequence, i_block + 1);
+            size_t first = i_block * constants::COVERAGE_BLOCK_SIZE;
+            size_t last = std::min(first + constants::COVERAGE_BLOCK_SIZE, n_sequences);
+            _sample_multinomial(weights, first, last, block_oligos[i_block], sampled_coverage, block_rng);
+        };
+        if (n_threads > 1 && n_blocks > 1) {
+            threadpool::ThreadPool pool(n_threads);
+            pool.parallel_for(n_blocks, sample_block);
+        } else {
+            for (size_t i_block = 0; i_block < n_blocks; i_block++) {
+                sample_block(i_block);
+            }
         }
 
         // calculate total number of oligos
-        int sampled_oligos_total = std::accumulate(sampled_coverage.begin(), sampled_coverage.end(), 0);
-        logger.info("Sampled total of {} oligos from {} sequences for a mean coverage of {}", sampled_oligos_total, relative_coverage.size(), (float)sampled_oligos_total / (float)relative_coverage.size());
+        uint64_t sampled_oligos_total = std::accumulate(sampled_coverage.begin(), sampled_coverage.end(), (uint64_t)0);
+        logger.info("Sampled total of {} oligos from {} sequences for a mean coverage of {}", sampled_oligos_total, n_sequences, (double)sampled_oligos_total / (double)n_sequences);
         return sampled_coverage;
     }
 
 
+    // sample a specific number of oligos from a relative coverage with replacement
+    std::vector<unsigned int> _sample_from_relative_coverage(std::vector<float> const &relative_coverage, const uint64_t n_oligos, const int n_threads) {
+        return _sample_from_weights(relative_coverage, n_oligos, n_threads);
+    }
+
+
     // sample from an initial relative coverage assuming a log-normal distribution of coverage
-    std::vector<unsigned int> get_initial_coverage(const int n_sequences, const float log_std, const int coverage) {
+    std::vector<unsigned int> get_initial_coverage(const uint64_t n_sequences, const float log_std, const int coverage, const int n_threads) {
         
         // create lognormal distribution with a mean of 0 and a standard deviation of log_std
         std::lognormal_distribution<float> lognorm_dist(0.0, log_std);
 
-        // generate a coverage for each sequence and normalize it
+        // generate a relative coverage for each sequence, the sampling does not require them to be normalized
         std::vector<float> rel_cov(n_sequences, 0.0);
-        for (int i = 0; i < n_sequences; i++) {
+        for (uint64_t i = 0; i < n_sequences; i++) {
             rel_cov[i] = lognorm_dist(rng::rng);
         }
-        float sum = std::accumulate(rel_cov.begin(), rel_cov.end(), 0.0);
-        for (int i = 0; i < n_sequences; i++) {
-            rel_cov[i] /= sum;
-        }
 
         // convert to absolute coverage by sampling
-        std::vector<unsigned int> sampled_oligos = _sample_from_relative_coverage(rel_cov, (int)n_sequences*coverage);
+        std::vector<unsigned int> sampled_oligos = _sample_from_relative_coverage(rel_cov, n_sequences * coverage, n_threads);
         return sampled_oligos;
     }
 
 
     // sample a specific number of oligos from a set of oligo counts representing abundance
-    std::vector<unsigned int> sample_by_count(std::vector<unsigned int> const &oligo_counts, const int n_sampled_oligos) {
-
-        // get number of unique oligos
-        const int n_oligos = oligo_counts.size();
-
-        // convert the absolute coverage to a relative coverage
-        std::vector<float> rel_cov = std::vector<float>(n_oligos, 0.0);
-        double total_oligos = std::accumulate(oligo_counts.begin(), oligo_counts.end(), 0.0);
-        for (int i = 0; i < n_oligos; i++) {
-            rel_cov[i] = (float)oligo_counts[i] / total_oligos;
-        }
-
-        // sample the oligos with replacement
-        std::vector<unsigned int> sampled_oligos = _sample_from_relative_coverage(rel_cov, n_sampled_oligos);
+    std::vector<unsigned int> sample_by_count(std::vector<unsigned int> const &oligo_counts, const uint64_t n_sampled_oligos, const int n_threads) {
+        // the counts are used as exact weights, without conversion to a relative coverage
+        std::vector<unsigned int> sampled_oligos = _sample_from_weights(oligo_counts, n_sampled_oligos, n_threads);
         return sampled_oligos;
     }
 
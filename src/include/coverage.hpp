@@ -2,14 +2,16 @@
 #define COVERAGE_HPP
 
 #include <vector>
+#include <cstdint>
 
 namespace coverage {
 
-    std::vector<unsigned int> _sample_from_relative_coverage(std::vector<float> const &relative_coverage, const int n_oligos);
+    // totals are counted in 64 bits, while the count of each single sequence is stored in 32 bits
+    std::vector<unsigned int> _sample_from_relative_coverage(std::vector<float> const &relative_coverage, const uint64_t n_oligos, const int n_threads = 1);
 
-    std::vector<unsigned int> get_initial_coverage(const int n_sequences, const float log_std, const int coverage = 100);
+    std::vector<unsigned int> get_initial_coverage(const uint64_t n_sequences, const float log_std, const int coverage = 100, const int n_threads = 1);
 
-    std::vector<unsigned int> sample_by_count(std::vector<unsigned int> const &oligo_counts, const int n_sampled_oligos);
+    std::vector<unsigned int> sample_by_count(std::vector<unsigned int> const &oligo_counts, const uint64_t n_sampled_oligos, const int n_threads = 1);
 
 } // namespace coverage
 
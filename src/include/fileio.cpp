@@ -3,6 +3,8 @@
 #include <string>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
+#include <cstring>
 
 #include "fileio.hpp"
 #include "conversion.hpp"
@@ -19,17 +21,18 @@ namespace fileio {
 
     // encapsulates the logic for reading sequences from a file
     SequenceFileReader::SequenceFileReader(const string& filename, ReadFileType filetype) {
+        this->filename = filename;
+        this->filetype = filetype;
+
+        // files are mapped into memory and scanned for the delimiters of their records
+        _mapped = std::make_unique<mappedfile::MappedFile>(filename);
+        _data_end = _mapped->size();
         if (filetype == ReadFileType::BINARY) {
-            _file.open(filename, std::ios::binary);
+            _read_header();
         } else {
-            _file.open(filename);
-        }
-        if (!_file.is_open()) {
-            logger.critical("Could not open file: " + filename);
-            throw std::runtime_error("Could not open file: " + filename);
+            _detect_text_format();
         }
-        this->filename = filename;
-        this->filetype = filetype;
+        _position = _mapped->begin() + _data_start;
     }
 
     SequenceFileReader::~SequenceFileReader() {
@@ -44,46 +47,180 @@ namespace fileio {
     }
 
     void SequenceFileReader::close() {
-        if (_file.is_open()) {
-            _file.close();
+        _mapped.reset();
+        _position = nullptr;
+    }
+
+    // read the header of a binary file and check that the file has been closed
+    void SequenceFileReader::_read_header() {
+        const char* data = _mapped->begin();
+        if (_mapped->size() < sizeof(BinaryFileHeader) || !std::equal(data, data + sizeof(constants::BINARY_FILE_MAGIC), constants::BINARY_FILE_MAGIC)) {
+            logger.critical("File {} is not a binary sequence file", filename);
+            throw std::runtime_error("File " + filename + " is not a binary sequence file");
         }
+        std::memcpy(&_header, data, sizeof(BinaryFileHeader));
+
+        // the multiplicities span to the end of the file, which is only the case once the file has been closed
+        if (_header.multiplicity_offset < sizeof(BinaryFileHeader) || _header.multiplicity_offset + _header.n_records * sizeof(unsigned int) != _mapped->size()) {
+            logger.critical("File {} has invalid multiplicities, it might not have been closed", filename);
+            throw std::runtime_error("File " + filename + " has invalid multiplicities, it might not have been closed");
+        }
+        _data_start = sizeof(BinaryFileHeader);
+        _data_end = _header.multiplicity_offset;
     }
 
-    // read a line from the file and store it in the sequence vector, vector overload
-    bool SequenceFileReader::_getline(std::vector<char>& sequence) {
-        sequence.clear();
+    // get a view of the packed bases of the next oligo of a binary file, returns false at the end of the file
+    bool SequenceFileReader::_next_oligo(const char*& packed, size_t& length) {
         if (filetype != ReadFileType::BINARY) {
             logger.critical("Cannot read binary data from a non-binary file");
             throw std::runtime_error("Cannot read binary data from a non-binary file");
         }
-        // read characters from the file until we reach a newline
-        char c;
-        while (_file.get(c)) {
-            if (c == constants::NUCLEOTIDE_NEXTOLIGO) {
-                return true;
+        const char* data_end = _mapped != nullptr ? _mapped->begin() + _data_end : nullptr;
+        if (_mapped == nullptr || _position >= data_end) {
+            return false;
+        }
+
+        // decode the length from a varint with 7 bits per byte, lowest first
+        length = 0;
+        int shift = 0;
+        while (true) {
+            if (_position >= data_end || shift > 63) {
+                logger.critical("File {} ends within the length of an oligo", filename);
+                throw std::runtime_error("File " + filename + " ends within the length of an oligo");
             }
-            sequence.push_back(c);
+            unsigned char byte = *_position++;
+            length |= (size_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+
+        // the packed bases follow the length
+        packed = _position;
+        size_t n_packed = (length + 3) / 4;
+        if ((size_t)(data_end - _position) < n_packed) {
+            logger.critical("File {} ends within an oligo", filename);
+            throw std::runtime_error("File " + filename + " ends within an oligo");
         }
-        return !sequence.empty();
+        _position += n_packed;
+        return true;
     }
 
-    // read a line from the file and store it in the sequence string, txt overload
-    bool SequenceFileReader::_getline(std::string& sequence) {
-        if (filetype != ReadFileType::ANY) {
-            logger.critical("Cannot read text data from a non-text file");
-            throw std::runtime_error("Cannot read text data from a non-text file");
+    // get the next line of a text file without its line ending, returns false at the end of the file
+    bool SequenceFileReader::_next_line(const char*& begin, const char*& end) {
+        if (_mapped == nullptr || _position >= _mapped->end()) {
+            return false;
         }
-        if (getline(_file, sequence)) {
-            return true;
+        begin = _position;
+        end = (const char*)std::memchr(_position, '\n', _mapped->end() - _position);
+        if (end == nullptr) {
+            end = _mapped->end();
+            _position = end;
         } else {
-            return false;
+            _position = end + 1;
+        }
+        if (end > begin && end[-1] == '\r') {
+            end--;
+        }
+        return true;
+    }
+
+    // determine the format of a text file from its first line
+    void SequenceFileReader::_detect_text_format() {
+        const char* first = _mapped->begin();
+        while (first < _mapped->end() && (*first == '\n' || *first == '\r')) {
+            first++;
+        }
+        if (first < _mapped->end() && *first == '>') {
+            _text_format = TextFormat::FASTA;
+            logger.debug("Reading file {} as FASTA", filename);
+        } else if (first < _mapped->end() && *first == '@') {
+            _text_format = TextFormat::FASTQ;
+            logger.debug("Reading file {} as FASTQ", filename);
+        } else {
+            _text_format = TextFormat::LINES;
+        }
+    }
+
+    // read the next valid sequence from a text file, in the layout of its format
+    bool SequenceFileReader::_next_record(std::vector<char>& sequence_vector) {
+        const char* begin;
+        const char* end;
+        while (true) {
+            sequence_vector.clear();
+            bool is_valid = true;
+
+            if (_text_format == TextFormat::LINES) {
+                if (!_next_line(begin, end)) {
+                    return false;
+                }
+                // skip empty lines and header lines
+                if (begin == end || *begin == '>' || *begin == '@' || *begin == '+') {
+                    skipped_lines++;
+                    continue;
+                }
+                is_valid = conversion::append_sequence(begin, end, sequence_vector);
+
+            } else if (_text_format == TextFormat::FASTA) {
+                // find the next header line
+                bool found_header = false;
+                while (_next_line(begin, end)) {
+                    if (begin < end && *begin == '>') {
+                        found_header = true;
+                        break;
+                    }
+                    skipped_lines++;
+                }
+                if (!found_header) {
+                    return false;
+                }
+                // join all lines up to the next header
+                while (_position < _mapped->end() && *_position != '>') {
+                    _next_line(begin, end);
+                    if (is_valid) {
+                        is_valid = conversion::append_sequence(begin, end, sequence_vector);
+                    }
+                }
+
+            } else {
+                // find the next header line
+                bool found_header = false;
+                while (_next_line(begin, end)) {
+                    if (begin < end && *begin == '@') {
+                        found_header = true;
+                        break;
+                    }
+                    skipped_lines++;
+                }
+                if (!found_header || !_next_line(begin, end)) {
+                    return false;
+                }
+                is_valid = conversion::append_sequence(begin, end, sequence_vector);
+                // skip the separator and the quality line
+                _next_line(begin, end);
+                _next_line(begin, end);
+            }
+
+            // skip sequences that are empty or contain chars other than A, C, G and T
+            if (!is_valid || sequence_vector.empty()) {
+                skipped_lines++;
+                continue;
+            }
+            valid_sequences++;
+            return true;
         }
     }
 
     // move the file pointer to the start of the file
     void SequenceFileReader::to_start() {
-        _file.clear();
-        _file.seekg(0);
+        if (_loaded) {
+            _loaded_position = 0;
+            return;
+        }
+        if (_mapped != nullptr) {
+            _position = _mapped->begin() + _data_start;
+        }
         skipped_lines = 0;
         valid_sequences = 0;
     }
@@ -118,9 +255,10 @@ namespace fileio {
             skipped_lines++;
             return false;
         }
-        // skip sequences that contain chars other than A, C, G and T
+        // skip sequences that contain chars other than A, C, G and T, whose integers are consecutive
+        static_assert(constants::NUCLEOTIDE_C == constants::NUCLEOTIDE_A + 1 && constants::NUCLEOTIDE_G == constants::NUCLEOTIDE_A + 2 && constants::NUCLEOTIDE_T == constants::NUCLEOTIDE_A + 3);
         for (char c : sequence_vector) {
-            if (c != constants::NUCLEOTIDE_A && c != constants::NUCLEOTIDE_C && c != constants::NUCLEOTIDE_G && c != constants::NUCLEOTIDE_T) {
+            if ((unsigned char)(c - constants::NUCLEOTIDE_A) > 3) {
                 skipped_lines++;
                 logger.warning("Skipping sequence with invalid nucleotide: {}", (int)c);
                 return false;
@@ -132,29 +270,63 @@ namespace fileio {
 
     // read the next valid sequence from the file
     bool SequenceFileReader::get_sequence(std::vector<char>& sequence_vector) {
+        if (_loaded) {
+            if (_loaded_position + 1 >= _loaded_offsets.size()) {
+                return false;
+            }
+            sequence_vector.assign(_loaded_bases.begin() + _loaded_offsets[_loaded_position], _loaded_bases.begin() + _loaded_offsets[_loaded_position + 1]);
+            _loaded_position++;
+            return true;
+        }
         if (filetype == ReadFileType::BINARY) {
-            while (_getline(sequence_vector)) {
-                if (check_valid_sequence(sequence_vector)) {
-                    return true;
+            // unpack the oligo into the vector, which keeps its capacity between oligos
+            const char* packed;
+            size_t length;
+            while (_next_oligo(packed, length)) {
+                if (length == 0) {
+                    skipped_lines++;
+                    continue;
                 }
+                sequence_vector.resize(length);
+                conversion::unpack_sequence(packed, length, sequence_vector.data());
+                valid_sequences++;
+                return true;
             }
             return false;
         } else {
-            while (_getline(_current_sequence)) {
-                if (check_valid_sequence(_current_sequence)) {
-                    conversion::sequence_to_vector(_current_sequence, sequence_vector);
-                    return true;
-                }
-            }
-            return false;
+            return _next_record(sequence_vector);
+        }
+    }
+
+    // read all valid sequences into memory in a single pass, such that they are served without reading the file again
+    void SequenceFileReader::load() {
+        if (_loaded) {
+            return;
+        }
+        to_start();
+        std::vector<char> sequence;
+        _loaded_offsets.assign(1, 0);
+        while (get_sequence(sequence)) {
+            _loaded_bases.insert(_loaded_bases.end(), sequence.begin(), sequence.end());
+            _loaded_offsets.push_back(_loaded_bases.size());
         }
+        _loaded = true;
+        _loaded_position = 0;
+        logger.debug("Loaded {} valid sequences ({} lines skipped) from file {}", _loaded_offsets.size() - 1, skipped_lines, filename);
     }
 
     // function that reads a file and returns the number of lines in it
-    int SequenceFileReader::count_sequences() {
+    uint64_t SequenceFileReader::count_sequences() {
+        // loaded files and binary files with a header do not need to be read again
+        if (_loaded) {
+            return _loaded_offsets.size() - 1;
+        }
+        if (filetype == ReadFileType::BINARY) {
+            return _header.n_records;
+        }
         to_start();
         std::vector<char> sequence;
-        int count = 0;
+        uint64_t count = 0;
         while (get_sequence(sequence)) {
             count++;
         }
@@ -165,6 +337,18 @@ namespace fileio {
 
 
 
+    // number of times each sequence of a binary file occurs in the pool
+    std::vector<unsigned int> SequenceFileReader::get_multiplicities() {
+        if (filetype != ReadFileType::BINARY || _mapped == nullptr) {
+            logger.critical("Multiplicities are only stored in binary files");
+            throw std::runtime_error("Multiplicities are only stored in binary files");
+        }
+        std::vector<unsigned int> multiplicities(_header.n_records);
+        std::memcpy(multiplicities.data(), _mapped->begin() + _header.multiplicity_offset, _header.n_records * sizeof(unsigned int));
+        return multiplicities;
+    }
+
+
     // encapsulates the logic for writing sequences to a file
     SequenceFileWriter::SequenceFileWriter(const string& filename, WriteFileType filetype) {
         if (filetype == WriteFileType::BINARY) {
@@ -178,6 +362,9 @@ namespace fileio {
         }
         this->filename = filename;
         this->filetype = filetype;
+        if (filetype == WriteFileType::BINARY) {
+            _write_header();
+        }
     }
 
     SequenceFileWriter::~SequenceFileWriter() {
@@ -193,19 +380,62 @@ namespace fileio {
 
     void SequenceFileWriter::close() {
         if (_file.is_open()) {
+            if (filetype == WriteFileType::BINARY) {
+                _write_trailer();
+            }
             _file.close();
         }
     }
 
+    // write the header of a binary file, the counts are filled in when the file is closed
+    void SequenceFileWriter::_write_header() {
+        BinaryFileHeader header = {};
+        std::memcpy(header.magic, constants::BINARY_FILE_MAGIC, sizeof(header.magic));
+        _file.write((char*)&header, sizeof(header));
+        _bytes_written = sizeof(header);
+    }
+
+    // write the multiplicities and the final header of a binary file
+    void SequenceFileWriter::_write_trailer() {
+        BinaryFileHeader header = {};
+        std::memcpy(header.magic, constants::BINARY_FILE_MAGIC, sizeof(header.magic));
+        header.n_records = sequences_written;
+        for (unsigned int multiplicity : _multiplicities) {
+            header.n_oligos += multiplicity;
+        }
+        header.multiplicity_offset = _bytes_written;
+        _file.write((char*)_multiplicities.data(), _multiplicities.size() * sizeof(unsigned int));
+        _file.seekp(0);
+        _file.write((char*)&header, sizeof(header));
+    }
+
     // write a single sequence for binary output
-    void SequenceFileWriter::_write_sequence_as_binary(const std::vector<char>& sequence_vector) {
+    void SequenceFileWriter::_write_sequence_as_binary(const char* sequence, size_t length, unsigned int multiplicity) {
         if (filetype != WriteFileType::BINARY) {
             logger.critical("Cannot write binary data to a non-binary file");
             throw std::runtime_error("Cannot write binary data to a non-binary file");
         }
-        // write the vector of chars to the file
-        _file.write((char*)&sequence_vector[0], sequence_vector.size() * sizeof(char));
-        _file.put(constants::NUCLEOTIDE_NEXTOLIGO);
+        // empty oligos would be skipped when reading, so they are not written and not counted
+        if (length == 0) {
+            return;
+        }
+        // encode the length as a varint with 7 bits per byte, followed by the packed bases
+        _packed.resize(10 + (length + 3) / 4);
+        size_t n_bytes = 0;
+        size_t varint = length;
+        while (varint >= 0x80) {
+            _packed[n_bytes++] = (char)((varint & 0x7F) | 0x80);
+            varint >>= 7;
+        }
+        _packed[n_bytes++] = (char)varint;
+        if (!conversion::pack_sequence(sequence, length, _packed.data() + n_bytes)) {
+            logger.critical("Cannot write sequence with invalid nucleotides to {}", filename);
+            throw std::runtime_error("Cannot write sequence with invalid nucleotides to " + filename);
+        }
+        n_bytes += (length + 3) / 4;
+        _file.write(_packed.data(), n_bytes);
+        _bytes_written += n_bytes;
+        _multiplicities.push_back(multiplicity);
         sequences_written++;
     }
 
@@ -228,21 +458,31 @@ namespace fileio {
     }
 
     // write a sequence vector to the file
-    void SequenceFileWriter::write_sequence_vector(const std::vector<char>& sequence_vector) {
+    void SequenceFileWriter::write_sequence_vector(const std::vector<char>& sequence_vector, unsigned int multiplicity) {
+        write_sequence(sequence_vector.data(), sequence_vector.size(), multiplicity);
+    }
+
+    // write a sequence of the given length to the file
+    void SequenceFileWriter::write_sequence(const char* sequence_data, size_t length, unsigned int multiplicity) {
         if (filetype == WriteFileType::BINARY) {
-            _write_sequence_as_binary(sequence_vector);
+            _write_sequence_as_binary(sequence_data, length, multiplicity);
         } else {
-            std::string sequence = conversion::vector_to_sequence(sequence_vector);
-            switch (filetype) {
-                case WriteFileType::TXT:
-                    _write_sequence_as_txt(sequence);
-                    break;
-                case WriteFileType::FASTA:
-                    _write_sequence_as_fasta(sequence);
-                    break;
-                case WriteFileType::FASTQ:
-                    _write_sequence_as_fastq(sequence);
-                    break;
+            std::string sequence = conversion::vector_to_sequence(sequence_data, length);
+            for (unsigned int i = 0; i < multiplicity; i++) {
+                switch (filetype) {
+                    case WriteFileType::TXT:
+                        _write_sequence_as_txt(sequence);
+                        break;
+                    case WriteFileType::FASTA:
+                        _write_sequence_as_fasta(sequence);
+                        break;
+                    case WriteFileType::FASTQ:
+                        _write_sequence_as_fastq(sequence);
+                        break;
+                    case WriteFileType::BINARY:
+                        // binary files are written above
+                        break;
+                }
             }
         }
     }
@@ -4,6 +4,10 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <memory>
+#include <cstdint>
+
+#include "mappedfile.hpp"
 
 
 namespace fileio {
@@ -14,21 +18,60 @@ namespace fileio {
         ANY,
     };
 
+    // header at the start of a binary sequence file
+    // each unique oligo follows as its length in a varint and its bases packed with 2 bits each,
+    // and the file ends with the multiplicity of each oligo
+    struct BinaryFileHeader {
+        char magic[8];
+        uint64_t n_records; // number of unique oligos stored in the file
+        uint64_t n_oligos; // number of oligos including their multiplicities
+        uint64_t multiplicity_offset; // position of the multiplicities in the file
+    };
+
+    // enum to store the layouts of text files
+    enum class TextFormat {
+        LINES, // one sequence per line
+        FASTA, // header lines starting with '>', followed by the lines of the sequence
+        FASTQ, // records of four lines, with the sequence in the second line
+    };
+
     // class to encapsulate sequence reading
     class SequenceFileReader {
         private:
-            std::ifstream _file;
-            std::string _current_sequence;
+            std::unique_ptr<mappedfile::MappedFile> _mapped;
+            const char* _position = nullptr;
+            TextFormat _text_format = TextFormat::LINES;
+            size_t _data_start = 0;
+            size_t _data_end = 0;
+            BinaryFileHeader _header = {};
+
+            // sequences held in memory after loading, concatenated with the offset of each sequence
+            bool _loaded = false;
+            std::vector<char> _loaded_bases;
+            std::vector<size_t> _loaded_offsets;
+            size_t _loaded_position = 0;
+
+            // get a view of the packed bases of the next oligo of a binary file, returns false at the end of the file
+            bool _next_oligo(const char*& packed, size_t& length);
+
+            // get the next line of a text file without its line ending, returns false at the end of the file
+            bool _next_line(const char*& begin, const char*& end);
 
-            bool _getline(std::string& sequence);
-            bool _getline(std::vector<char>& sequence);
+            // read the next valid sequence from a text file, in the layout of its format
+            bool _next_record(std::vector<char>& sequence_vector);
+
+            // determine the format of a text file from its first line
+            void _detect_text_format();
+
+            // read the header of a binary file and check that the file has been closed
+            void _read_header();
 
 
         public:
             std::string filename;
             ReadFileType filetype;
-            int skipped_lines = 0;
-            int valid_sequences = 0;
+            uint64_t skipped_lines = 0;
+            uint64_t valid_sequences = 0;
 
             SequenceFileReader(const std::string& filename, ReadFileType filetype = ReadFileType::ANY);
 
@@ -48,8 +91,14 @@ namespace fileio {
             // read the next valid sequence from the file as sequence vector
             bool get_sequence(std::vector<char>& sequence_vector);
 
+            // read all valid sequences into memory in a single pass, such that they are served without reading the file again
+            void load();
+
             // function to count the number of sequences in the file
-            int count_sequences();
+            uint64_t count_sequences();
+
+            // number of times each sequence of a binary file occurs in the pool
+            std::vector<unsigned int> get_multiplicities();
     };
 
 
@@ -65,9 +114,18 @@ namespace fileio {
     class SequenceFileWriter {
         private:
             std::ofstream _file;
+            uint64_t _bytes_written = 0;
+            std::vector<unsigned int> _multiplicities;
+            std::vector<char> _packed;
+
+            // write the header of a binary file, the counts are filled in when the file is closed
+            void _write_header();
+
+            // write the multiplicities and the final header of a binary file
+            void _write_trailer();
 
             // write a single sequence for binary output
-            void _write_sequence_as_binary(const std::vector<char>& sequence_vector);
+            void _write_sequence_as_binary(const char* sequence, size_t length, unsigned int multiplicity);
 
             // write a single sequence for txt output
             void _write_sequence_as_txt(const std::string& sequence);
@@ -81,7 +139,7 @@ namespace fileio {
         public:
             std::string filename;
             WriteFileType filetype;
-            int sequences_written = 0;
+            uint64_t sequences_written = 0;
 
             SequenceFileWriter(const std::string& filename, WriteFileType filetype = WriteFileType::TXT);
 
@@ -92,7 +150,11 @@ namespace fileio {
             void close();
 
             // write a sequence vector to the file
-            void write_sequence_vector(const std::vector<char>& sequence_vector);
+            // a sequence with a multiplicity is stored once in binary files and repeated in text files
+            void write_sequence_vector(const std::vector<char>& sequence_vector, unsigned int multiplicity = 1);
+
+            // write a sequence of the given length to the file, in the same way as a sequence vector
+            void write_sequence(const char* sequence, size_t length, unsigned int multiplicity = 1);
     };
     
     
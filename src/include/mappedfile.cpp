@@ -0,0 +1,101 @@
+#include <string>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#include "mappedfile.hpp"
+#include "logging.hpp"
+
+static Logger logger("mappedfile", "INFO");
+
+namespace mappedfile {
+
+#ifndef _WIN32
+
+    // map the whole file into memory and advise the kernel that it is read front to back
+    MappedFile::MappedFile(const std::string& filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            logger.critical("Could not open file: " + filename);
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0) {
+            ::close(fd);
+            logger.critical("Could not get the size of file: " + filename);
+            throw std::runtime_error("Could not get the size of file: " + filename);
+        }
+        _size = file_stat.st_size;
+
+        // empty files cannot be mapped, but there is nothing to read from them anyway
+        if (_size > 0) {
+            void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ::close(fd);
+                logger.critical("Could not map file: " + filename);
+                throw std::runtime_error("Could not map file: " + filename);
+            }
+            madvise(mapping, _size, MADV_SEQUENTIAL);
+            _data = (const char*)mapping;
+            _mapped = true;
+        }
+        ::close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (_mapped) {
+            munmap((void*)_data, _size);
+        }
+    }
+
+#else
+
+    // map the whole file into memory through the windows api
+    MappedFile::MappedFile(const std::string& filename) {
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            logger.critical("Could not open file: " + filename);
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            CloseHandle(file);
+            logger.critical("Could not get the size of file: " + filename);
+            throw std::runtime_error("Could not get the size of file: " + filename);
+        }
+        _size = file_size.QuadPart;
+
+        // empty files cannot be mapped, but there is nothing to read from them anyway
+        if (_size > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping != nullptr) {
+                CloseHandle(mapping);
+            }
+            if (view == nullptr) {
+                CloseHandle(file);
+                logger.critical("Could not map file: " + filename);
+                throw std::runtime_error("Could not map file: " + filename);
+            }
+            _data = (const char*)view;
+            _mapped = true;
+        }
+        CloseHandle(file);
+    }
+
+    MappedFile::~MappedFile() {
+        if (_mapped) {
+            UnmapViewOfFile(_data);
+        }
+    }
+
+#endif
+
+} // namespace mappedfile
@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+#include <cstddef>
+
+
+namespace mappedfile {
+
+    // read-only view of a whole file, memory-mapped with mmap or, on windows, a file mapping
+    class MappedFile {
+        private:
+            const char* _data = nullptr;
+            size_t _size = 0;
+            bool _mapped = false;
+
+        public:
+            MappedFile(const std::string& filename);
+
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* data() const { return _data; }
+            size_t size() const { return _size; }
+            const char* begin() const { return _data; }
+            const char* end() const { return _data + _size; }
+    };
+
+} // namespace mappedfile
+
+
+#endif // MAPPEDFILE_HPP
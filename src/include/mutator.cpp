@@ -1,7 +1,12 @@
 #include <vector>
 #include <stdexcept>
 #include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
 
+#include "constants.hpp"
 #include "conversion.hpp"
 #include "mutator.hpp"
 #include "rng.hpp"
@@ -12,24 +17,74 @@ static Logger logger("mutator", "INFO");
 
 namespace mutator {
 
-    // handles the processing of a set of oligos
-    void BaseMutator::process(std::vector<std::vector<char>> &oligos) {
+    // copy a segment of bases in chunks of fixed size, which avoids dispatching on the length of short segments
+    // the destination needs SEGMENT_CHUNK_SIZE bytes of space past the segment, the source is read only within its readable bytes
+    static void copy_segment(char *destination, const char *source, size_t length, size_t readable) {
+        if (length + constants::SEGMENT_CHUNK_SIZE > readable) {
+            std::memcpy(destination, source, length);
+            return;
+        }
+        for (size_t i = 0; i < length; i += constants::SEGMENT_CHUNK_SIZE) {
+            std::memcpy(destination + i, source + i, constants::SEGMENT_CHUNK_SIZE);
+        }
+    }
+
+
+    // handles the processing of a set of oligos by a mutator that only cuts or drops oligos, such that its resulting
+    // oligos remain views of the bases in the batch and no base is copied
+    template <typename Mutator>
+    void process_batch_as_views(Mutator &mutator, oligobatch::OligoBatch &oligos) {
+        // the views are collected in buffers kept by the thread, which are exchanged with those of the batch
+        static thread_local std::vector<size_t> offsets;
+        static thread_local std::vector<size_t> lengths;
+        static thread_local std::vector<char> strands;
+        offsets.clear();
+        lengths.clear();
+        strands.clear();
+
+        // the views the mutators take from each oligo keep its strand, unless they reverse it
+        arena::vector<OligoView> views(arena::resource());
+        for (size_t i = 0; i < oligos.size(); i++) {
+            views.clear();
+            mutator._process_view(OligoView{std::span<char>(oligos.data(i), oligos.length(i)), oligos.reverse(i)}, views);
+            for (OligoView view : views) {
+                offsets.push_back(oligos.offset(i) + (view.bases.data() - oligos.data(i)));
+                lengths.push_back(view.size());
+                strands.push_back(view.reverse);
+            }
+        }
+        oligos.set_views(offsets, lengths, strands);
+    }
+
+    // handles the processing of a set of oligos, one oligo after another
+    void BaseMutator::process_batch(oligobatch::OligoBatch &oligos) {
+        // each oligo is processed in a buffer and stored in a new batch, both are kept by the thread for reuse
+        static thread_local std::vector<char> oligo;
+        static thread_local oligobatch::OligoBatch new_oligos;
+        new_oligos.clear();
+
         // loop through each oligo and process it
-        if (this->get_manipulates_count()) {
-            std::vector<std::vector<char>> new_oligos;
-            for (std::vector<char> &oligo : oligos) {
+        for (size_t i = 0; i < oligos.size(); i++) {
+            oligos.get(i, oligo);
+            if (this->get_manipulates_count()) {
                 process_single_with_new(oligo, new_oligos);
-            }
-            // replace the new oligos in the results
-            oligos.clear();
-            if (new_oligos.size() > 0) {
-                oligos = new_oligos;
-            }
-        } else {
-            for (std::vector<char> &oligo : oligos) {
+            } else {
                 process_single(oligo);
+                new_oligos.push_back(oligo);
             }
         }
+
+        // replace the new oligos in the results
+        oligos.swap(new_oligos);
+    }
+
+    // handles the processing of a single oligo in place
+    void BaseMutator::process(std::vector<char> &oligo) {
+        if (this->get_manipulates_count()) {
+            logger.critical("{} changes the number of oligos and cannot process a single oligo in place.", get_name());
+            throw std::runtime_error(get_name() + " changes the number of oligos and cannot process a single oligo in place.");
+        }
+        process_single(oligo);
     }
 
     void BaseMutator::normalize_vector(std::vector<float> &vec) {
@@ -47,31 +102,90 @@ namespace mutator {
         return rng::random_float() < probability;
     }
 
-    // get the positions of events in a vector based on a probability distribution
-    std::vector<int> BaseMutator::get_event_positions(std::vector<float>const &p_event_by_position) {
-        std::vector<int> event_positions;
-        for (int i = 0; i < p_event_by_position.size(); i++) {
-            if (is_mutation(p_event_by_position[i])) {
-                event_positions.push_back(i);
+    // draw the number of positions without event before the next event, which is geometrically distributed
+    int BaseMutator::draw_gap(double log_p_no_event) {
+        double gap = std::floor(std::log(1.0 - rng::random_double()) / log_p_no_event);
+        if (gap >= std::numeric_limits<int>::max()) {
+            return std::numeric_limits<int>::max();
+        }
+        return (int)gap;
+    }
+
+    // get the positions of events with the same probability at each position, by skipping from event
+    // to event with geometrically distributed gaps instead of testing each position
+    arena::vector<int> BaseMutator::get_event_positions(int length, float probability) {
+        arena::vector<int> event_positions(arena::resource());
+        if (probability <= 0.0) {
+            return event_positions;
+        }
+        if (probability >= 1.0) {
+            event_positions.resize(length);
+            std::iota(event_positions.begin(), event_positions.end(), 0);
+            return event_positions;
+        }
+        double log_p_no_event = std::log1p(-(double)probability);
+        long position = (long)draw_gap(log_p_no_event);
+        while (position < length) {
+            event_positions.push_back(position);
+            position += 1 + (long)draw_gap(log_p_no_event);
+        }
+        return event_positions;
+    }
+
+    // get the positions of events with a probability depending on the base at each position, by drawing 
+    // candidates at the maximum probability and thinning them to the probability of the actual base
+    arena::vector<int> BaseMutator::get_event_positions(std::span<const char> oligo, std::vector<float> const &p_event_by_base) {
+        float p_max = std::min(*std::max_element(p_event_by_base.begin(), p_event_by_base.end()), 1.0f);
+        arena::vector<int> event_positions = get_event_positions(oligo.size(), p_max);
+        keep_events_by_base(oligo, event_positions, p_event_by_base, p_max);
+        return event_positions;
+    }
+
+    // keep each candidate position with the ratio of the base's probability to the maximum probability
+    void BaseMutator::keep_events_by_base(std::span<const char> oligo, arena::vector<int> &event_positions, std::vector<float> const &p_event_by_base, float p_max) {
+        size_t n_accepted = 0;
+        for (int position : event_positions) {
+            float p_event = p_event_by_base[oligo[position] - 1];
+            if (p_event >= p_max || is_mutation(p_event / p_max)) {
+                event_positions[n_accepted] = position;
+                n_accepted++;
             }
         }
+        event_positions.resize(n_accepted);
+    }
+
+    // get the positions of events from start onwards given the cumulative hazard up to each position, by drawing the
+    // hazard at which the next event occurs and searching its position, with a single draw per event
+    arena::vector<int> BaseMutator::get_event_positions(std::span<const double> cumulative_hazard, int start) {
+        arena::vector<int> event_positions(arena::resource());
+        const int length = cumulative_hazard.size() - 1;
+        int position = start;
+        while (position < length) {
+            double target = cumulative_hazard[position] - std::log(1.0 - rng::random_double());
+            if (target >= cumulative_hazard.back()) {
+                break;
+            }
+            position = std::upper_bound(cumulative_hazard.begin() + position + 1, cumulative_hazard.end(), target) - cumulative_hazard.begin() - 1;
+            event_positions.push_back(position);
+            position++;
+        }
         return event_positions;
     }
 
     // get the positions of events in a vector based on a probability distribution
-    void BaseMutator::draw_from_distribution(std::vector<int> &draws, std::discrete_distribution<> &sampler) {
+    void BaseMutator::draw_from_distribution(std::span<int> draws, const sampler::AliasSampler &sampler) {
         for (int &draw : draws) {
             draw = sampler(rng::rng);
         }
     }
-    void BaseMutator::draw_from_distribution(std::vector<char> &draws, std::discrete_distribution<> &sampler) {
+    void BaseMutator::draw_from_distribution(std::span<char> draws, const sampler::AliasSampler &sampler) {
         for (char &draw : draws) {
             draw = sampler(rng::rng);
         }
     }
 
     // this function must be overwritten by a derived class
-    void BaseMutator::process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) {
+    void BaseMutator::process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) {
         logger.critical("process_single_with_new() for new oligos must be overwritten by a derived class.");
         throw std::runtime_error("process_single_with_new() for new oligos must be overwritten by a derived class.");
     }
@@ -80,6 +194,15 @@ namespace mutator {
         throw std::runtime_error("process_single() for existing oligos must be overwritten by a derived class.");
     }
 
+    // mutators with independent events at each position provide their probabilities, all others return false
+    bool BaseMutator::get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const {
+        return false;
+    }
+    bool BaseMutator::process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event) {
+        logger.critical("process_single_with_hazard() must be overwritten by a derived class that provides event probabilities.");
+        throw std::runtime_error("process_single_with_hazard() must be overwritten by a derived class that provides event probabilities.");
+    }
+
 
 
     //
@@ -98,7 +221,7 @@ namespace mutator {
         }
         this->p_base_preference = p_base_preference;
         normalize_vector(this->p_base_preference);
-        this->_base_sampler = std::discrete_distribution<>(p_base_preference.begin(), p_base_preference.end());
+        this->_base_sampler = sampler::AliasSampler(p_base_preference.begin(), p_base_preference.end());
 
         // initialize the probability of event lengths
         if (p_event_lengths.size() == 0) {
@@ -108,44 +231,73 @@ namespace mutator {
             this->_custom_event_lengths = true;
             this->p_event_lengths = p_event_lengths;
             normalize_vector(this->p_event_lengths);
-            this->_event_lengths_sampler = std::discrete_distribution<>(p_event_lengths.begin(), p_event_lengths.end());
+            this->_event_lengths_sampler = sampler::AliasSampler(p_event_lengths.begin(), p_event_lengths.end());
         }
     }
 
     // handles the insertion of a random base into a random position in the oligo
     void InsertionEvents::process_single(std::vector<char> &oligo) {
         // get the positions of the events, insertions are equally likely at each position
-        std::vector<int> event_positions = get_event_positions(std::vector<float>(oligo.size(), rate));
+        arena::vector<int> event_positions = get_event_positions(oligo.size(), rate);
+        _apply_events(oligo, event_positions);
+    }
 
-        // short-circuit if there are no events
-        if (event_positions.size() == 0) {
-            return;
+    // the probability of an insertion after each position of the oligo
+    bool InsertionEvents::get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const {
+        p_event.assign(oligo.size(), std::min((double)rate, 1.0));
+        return true;
+    }
+
+    // handles the insertions in an unmodified oligo with events drawn from its cumulative hazard, given that the first
+    // one occurs at first_event if it is not negative
+    bool InsertionEvents::process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event) {
+        arena::vector<int> event_positions = get_event_positions(cumulative_hazard, first_event + 1);
+        if (first_event >= 0) {
+            event_positions.insert(event_positions.begin(), first_event);
         }
+        _apply_events(oligo, event_positions);
+        return !event_positions.empty();
+    }
 
-        // generate event lengths
-        std::vector<int> event_length(event_positions.size(), 1);
+    // draws the number of bases inserted by each event
+    arena::vector<int> InsertionEvents::_draw_event_lengths(size_t n_events) {
+        arena::vector<int> event_length(n_events, 1, arena::resource());
         if (this->_custom_event_lengths) {
             draw_from_distribution(event_length, _event_lengths_sampler);
             for (int &len : event_length) {
                 len += 1;
             }
         }
-        int total_insertions = std::accumulate(event_length.begin(), event_length.end(), 0);
+        return event_length;
+    }
 
-        // generate new bases
-        std::vector<char> new_bases(total_insertions, 1);
+    // draws the bases inserted by all events
+    arena::vector<char> InsertionEvents::_draw_new_bases(int n_bases) {
+        arena::vector<char> new_bases(n_bases, 1, arena::resource());
         draw_from_distribution(new_bases, _base_sampler);
         for (char &base : new_bases) {
             base += 1;
         }
+        return new_bases;
+    }
+
+    // inserts random bases after the event positions
+    void InsertionEvents::_apply_events(std::vector<char> &oligo, arena::vector<int> const &event_positions) {
+        // short-circuit if there are no events
+        if (event_positions.size() == 0) {
+            return;
+        }
+
+        // generate event lengths and new bases
+        arena::vector<int> event_length = _draw_event_lengths(event_positions.size());
+        int total_insertions = std::accumulate(event_length.begin(), event_length.end(), 0);
+        arena::vector<char> new_bases = _draw_new_bases(total_insertions);
 
         // insert the new bases into the oligo, starting from the back
-        int length;
-        int offset = 0;
-        for (int i = event_positions.size() - 1; i >= 0; i--) {
-            length = event_length[i];
-            oligo.insert(oligo.begin() + event_positions[i] + 1, new_bases.begin() + offset, new_bases.begin() + offset + length);
-            offset += length;
+        size_t offset = 0;
+        for (size_t i = event_positions.size(); i-- > 0;) {
+            oligo.insert(oligo.begin() + event_positions[i] + 1, new_bases.begin() + offset, new_bases.begin() + offset + event_length[i]);
+            offset += event_length[i];
         }
     }
 
@@ -167,6 +319,12 @@ namespace mutator {
         this->p_base_preference = p_base_preference;
         normalize_vector(this->p_base_preference);
 
+        // get the probability of an event at each base type, 4 is to go from probability to rate
+        this->_p_event_by_base = std::vector<float>(4, 0.0);
+        for (int i = 0; i < 4; i++) {
+            this->_p_event_by_base[i] = std::min(4 * rate * this->p_base_preference[i], 1.0f);
+        }
+
         // initialize the probability of event lengths
         if (p_event_lengths.size() == 0) {
             this->_custom_event_lengths = false;
@@ -175,42 +333,64 @@ namespace mutator {
             this->_custom_event_lengths = true;
             this->p_event_lengths = p_event_lengths;
             normalize_vector(this->p_event_lengths);
-            this->_event_lengths_sampler = std::discrete_distribution<>(p_event_lengths.begin(), p_event_lengths.end());
+            this->_event_lengths_sampler = sampler::AliasSampler(p_event_lengths.begin(), p_event_lengths.end());
         }
     }
 
     // handles the deletion of a random base at a random position in the oligo
     void DeletionEvents::process_single(std::vector<char> &oligo) {
         // get the positions of the events, deletions are influenced by base type
-        std::vector<float> p_event_by_position(oligo.size(), 4 * rate); // 4 is to go from probability to rate
-        for (int i = 0; i < oligo.size(); i++) {
-            p_event_by_position[i] *= p_base_preference[oligo[i] - 1];
+        arena::vector<int> event_positions = get_event_positions(oligo, _p_event_by_base);
+        _apply_events(oligo, event_positions);
+    }
+
+    // the probability of a deletion starting at each position of the oligo
+    bool DeletionEvents::get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const {
+        p_event.resize(oligo.size());
+        for (size_t i = 0; i < oligo.size(); i++) {
+            p_event[i] = _p_event_by_base[oligo[i] - 1];
         }
-        std::vector<int> event_positions = get_event_positions(p_event_by_position);
+        return true;
+    }
 
-        // short-circuit if there are no events
-        if (event_positions.size() == 0) {
-            return;
+    // handles the deletions in an unmodified oligo with events drawn from its cumulative hazard, given that the first
+    // one occurs at first_event if it is not negative
+    bool DeletionEvents::process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event) {
+        arena::vector<int> event_positions = get_event_positions(cumulative_hazard, first_event + 1);
+        if (first_event >= 0) {
+            event_positions.insert(event_positions.begin(), first_event);
         }
+        _apply_events(oligo, event_positions);
+        return !event_positions.empty();
+    }
 
-        // generate event lengths
-        std::vector<int> event_length(event_positions.size(), 1);
+    // draws the number of bases deleted by each event
+    arena::vector<int> DeletionEvents::_draw_event_lengths(size_t n_events) {
+        arena::vector<int> event_length(n_events, 1, arena::resource());
         if (this->_custom_event_lengths) {
             draw_from_distribution(event_length, _event_lengths_sampler);
             for (int &len : event_length) {
                 len += 1;
             }
         }
+        return event_length;
+    }
+
+    // deletes the bases starting at the event positions
+    void DeletionEvents::_apply_events(std::vector<char> &oligo, arena::vector<int> const &event_positions) {
+        // short-circuit if there are no events
+        if (event_positions.size() == 0) {
+            return;
+        }
+
+        // generate event lengths
+        arena::vector<int> event_length = _draw_event_lengths(event_positions.size());
         
         // delete the bases from the oligo, starting from the back
-        int length;
-        for (int i = event_positions.size() - 1; i >= 0; i--) {
-            length = event_length[i];
+        for (size_t i = event_positions.size(); i-- > 0;) {
             // make sure the deletion doesn't go past the end of the oligo
-            if (event_positions[i] + length > oligo.size()) {
-                length = oligo.size() - event_positions[i];
-            }
-            oligo.erase(oligo.begin() + event_positions[i], oligo.begin() + event_positions[i] + length);
+            size_t end = std::min((size_t)event_positions[i] + event_length[i], oligo.size());
+            oligo.erase(oligo.begin() + event_positions[i], oligo.begin() + end);
         }
     }
 
@@ -241,6 +421,12 @@ namespace mutator {
         }
         this->p_base_preference = p_base_preference;
         normalize_vector(this->p_base_preference);
+
+        // get the probability of an event at each base type, 4 is to go from probability to rate
+        this->_p_event_by_base = std::vector<float>(4, 0.0);
+        for (int i = 0; i < 4; i++) {
+            this->_p_event_by_base[i] = std::min(4 * rate * this->p_base_preference[i], 1.0f);
+        }
         
         // construct the sampler for the base preferences
         for (int i = 0; i < 4; i++) {
@@ -249,7 +435,7 @@ namespace mutator {
                 p_base_preference[j] = p_base_preference_list[i*3 + j];
             }
             normalize_vector(p_base_preference);
-            this->_base_sampler.push_back(std::discrete_distribution<>(p_base_preference.begin(), p_base_preference.end()));
+            this->_base_sampler.push_back(sampler::AliasSampler(p_base_preference.begin(), p_base_preference.end()));
         }
 
         // initialize the probability of event lengths
@@ -260,26 +446,78 @@ namespace mutator {
             this->_custom_event_lengths = true;
             this->p_event_lengths = p_event_lengths;
             normalize_vector(this->p_event_lengths);
-            this->_event_lengths_sampler = std::discrete_distribution<>(p_event_lengths.begin(), p_event_lengths.end());
+            this->_event_lengths_sampler = sampler::AliasSampler(p_event_lengths.begin(), p_event_lengths.end());
         }
     }
 
     // handles the substitutions of bases at a random position in the oligo
     void SubstitutionEvents::process_single(std::vector<char> &oligo) {
         // get the positions of the events, substitutions are influenced by base type
-        std::vector<float> p_event_by_position(oligo.size(), 4 * rate); // 4 is to go from probability to rate
-        for (int i = 0; i < oligo.size(); i++) {
-            p_event_by_position[i] *= p_base_preference[oligo[i] - 1];
+        arena::vector<int> event_positions = get_event_positions(oligo, _p_event_by_base);
+        _apply_events(oligo, event_positions);
+    }
+
+    // handles the substitutions of all oligos of a batch, with the candidate positions drawn over the bases of all oligos
+    // one after another, skipping the gaps between them, such that an oligo without any event costs no draw at all
+    void SubstitutionEvents::process_batch(oligobatch::OligoBatch &oligos) {
+        // the bases are only substituted as they are stored if they are the forward strands of the oligos, each only once
+        if (!oligos.in_order() || oligos.has_reverse()) {
+            oligos.normalize();
         }
-        std::vector<int> event_positions = get_event_positions(p_event_by_position);
-    
+        size_t n_oligo_bases = oligos.n_bases() - oligos.n_gap_bases();
+        if (n_oligo_bases > std::numeric_limits<int>::max()) {
+            BaseMutator::process_batch(oligos);
+            return;
+        }
+        float p_max = std::min(*std::max_element(_p_event_by_base.begin(), _p_event_by_base.end()), 1.0f);
+        arena::vector<int> event_positions = get_event_positions((int)n_oligo_bases, p_max);
+
+        // hand the candidates within each oligo to it, relative to its first base, and keep them by the bases they hit
+        arena::vector<int> oligo_events(arena::resource());
+        size_t i_event = 0;
+        int start = 0;
+        for (size_t i = 0; i < oligos.size() && i_event < event_positions.size(); i++) {
+            std::span<char> oligo(oligos.data(i), oligos.length(i));
+            int end = start + (int)oligo.size();
+            oligo_events.clear();
+            for (; i_event < event_positions.size() && event_positions[i_event] < end; i_event++) {
+                oligo_events.push_back(event_positions[i_event] - start);
+            }
+            keep_events_by_base(oligo, oligo_events, _p_event_by_base, p_max);
+            _apply_events(oligo, oligo_events);
+            start = end;
+        }
+    }
+
+    // the probability of a substitution starting at each position of the oligo
+    bool SubstitutionEvents::get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const {
+        p_event.resize(oligo.size());
+        for (size_t i = 0; i < oligo.size(); i++) {
+            p_event[i] = _p_event_by_base[oligo[i] - 1];
+        }
+        return true;
+    }
+
+    // handles the substitutions in an unmodified oligo with events drawn from its cumulative hazard, given that the first
+    // one occurs at first_event if it is not negative
+    bool SubstitutionEvents::process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event) {
+        arena::vector<int> event_positions = get_event_positions(cumulative_hazard, first_event + 1);
+        if (first_event >= 0) {
+            event_positions.insert(event_positions.begin(), first_event);
+        }
+        _apply_events(oligo, event_positions);
+        return !event_positions.empty();
+    }
+
+    // substitutes the bases starting at the event positions
+    void SubstitutionEvents::_apply_events(std::span<char> oligo, arena::vector<int> const &event_positions) {
         // short-circuit if there are no events
         if (event_positions.size() == 0) {
             return;
         }
 
         // generate event lengths
-        std::vector<int> event_length(event_positions.size(), 1);
+        arena::vector<int> event_length(event_positions.size(), 1, arena::resource());
         if (this->_custom_event_lengths) {
             draw_from_distribution(event_length, _event_lengths_sampler);
             for (int &len : event_length) {
@@ -301,16 +539,19 @@ namespace mutator {
             }
         }
 
-        // generate new bases for each base type
-        std::vector<std::vector<char>> new_bases;
-        new_bases.resize(4);
+        // generate new bases for each base type, stored one base type after another
+        arena::vector<char> new_bases_buffer(total_substitutions, 1, arena::resource());
+        std::span<char> new_bases[4];
+        int start = 0;
+        for (int i = 0; i < 4; i++) {
+            new_bases[i] = std::span<char>(new_bases_buffer.data() + start, total_substitutions_by_base[i]);
+            start += total_substitutions_by_base[i];
+        }
         for (int i = 0; i < 4; i++) {
             int n_bases = total_substitutions_by_base[i];
             if (n_bases == 0) {
                 continue;
             }
-            new_bases[i].clear();
-            new_bases[i].resize(total_substitutions_by_base[i], 1);
             draw_from_distribution(new_bases[i], _base_sampler[i]);
             for (char &base : new_bases[i]) {
                 base += 1; // go from 0-3 to 1-4
@@ -321,7 +562,6 @@ namespace mutator {
         }
         
         // substitute the new bases into the oligo
-        int length;
         int offset[4] = {0, 0, 0, 0};
         for (int i = 0; i < event_positions.size(); i++) {
             int pos = event_positions[i];
@@ -341,6 +581,201 @@ namespace mutator {
 
 
 
+    //
+    // ERROR CHANNEL
+    //
+
+    // constructor for the ErrorChannel class, which takes over the mutators it combines
+    ErrorChannel::ErrorChannel(std::unique_ptr<SubstitutionEvents> substitution, std::unique_ptr<DeletionEvents> deletion, std::unique_ptr<InsertionEvents> insertion) {
+        if (!substitution && !deletion && !insertion) {
+            logger.critical("An error channel needs at least one of substitutions, deletions and insertions.");
+            throw std::runtime_error("An error channel needs at least one of substitutions, deletions and insertions.");
+        }
+        this->_substitution = std::move(substitution);
+        this->_deletion = std::move(deletion);
+        this->_insertion = std::move(insertion);
+    }
+
+    // handles the substitutions, deletions and insertions of an oligo
+    void ErrorChannel::process_single(std::vector<char> &oligo) {
+        _apply_stages(oligo, {}, -1);
+    }
+
+    // the probabilities of the stages one after another, each over the positions of the unmodified oligo
+    bool ErrorChannel::get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const {
+        arena::vector<double> p_stage(arena::resource());
+        p_event.clear();
+        if (_substitution) {
+            _substitution->get_event_probabilities(oligo, p_stage);
+            p_event.insert(p_event.end(), p_stage.begin(), p_stage.end());
+        }
+        if (_deletion) {
+            _deletion->get_event_probabilities(oligo, p_stage);
+            p_event.insert(p_event.end(), p_stage.begin(), p_stage.end());
+        }
+        if (_insertion) {
+            _insertion->get_event_probabilities(oligo, p_stage);
+            p_event.insert(p_event.end(), p_stage.begin(), p_stage.end());
+        }
+        return true;
+    }
+
+    // handles an unmodified oligo with events drawn from the cumulative hazard of all stages, given that the first one
+    // occurs at slot first_event if it is not negative
+    bool ErrorChannel::process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event) {
+        return _apply_stages(oligo, cumulative_hazard, first_event);
+    }
+
+    // get the events of a stage of an unmodified oligo from the cumulative hazard of its slots, there are none in the
+    // stages before the one of the first event
+    arena::vector<int> ErrorChannel::_get_stage_events(std::span<const double> cumulative_hazard, int stage, int length, int first_event) {
+        std::span<const double> stage_hazard = cumulative_hazard.subspan(stage * length, length + 1);
+        if (first_event < 0 || first_event / length < stage) {
+            return get_event_positions(stage_hazard);
+        }
+        if (first_event / length > stage) {
+            return arena::vector<int>(arena::resource());
+        }
+        arena::vector<int> event_positions = get_event_positions(stage_hazard, first_event % length + 1);
+        event_positions.insert(event_positions.begin(), first_event % length);
+        return event_positions;
+    }
+
+    // applies the stages with the same draws as the mutators one after another, the stages use the cumulative hazard if
+    // it is given until the first event, returns false if no event occurred
+    bool ErrorChannel::_apply_stages(std::vector<char> &oligo, std::span<const double> cumulative_hazard, int first_event) {
+        const size_t length = oligo.size();
+        const bool use_hazard = !cumulative_hazard.empty();
+        bool any_event = false;
+        int stage = 0;
+
+        // substitutions do not change the length and are applied in place
+        if (_substitution) {
+            arena::vector<int> event_positions = (use_hazard && !any_event) ? _get_stage_events(cumulative_hazard, stage, length, first_event) : get_event_positions(oligo, _substitution->_p_event_by_base);
+            _substitution->_apply_events(oligo, event_positions);
+            any_event = any_event || !event_positions.empty();
+            stage++;
+        }
+
+        // deletions are drawn on the substituted oligo, overlapping deletions remove the same bases as when applied one by one
+        arena::vector<int> deletion_positions(arena::resource());
+        arena::vector<int> deletion_length(arena::resource());
+        size_t n_remaining = length;
+        if (_deletion) {
+            deletion_positions = (use_hazard && !any_event) ? _get_stage_events(cumulative_hazard, stage, length, first_event) : get_event_positions(oligo, _deletion->_p_event_by_base);
+            if (!deletion_positions.empty()) {
+                deletion_length = _deletion->_draw_event_lengths(deletion_positions.size());
+            }
+            size_t deleted_end = 0;
+            for (size_t i = 0; i < deletion_positions.size(); i++) {
+                size_t deletion_start = std::max((size_t)deletion_positions[i], deleted_end);
+                deleted_end = std::min(deletion_start + deletion_length[i], length);
+                n_remaining -= deleted_end - deletion_start;
+            }
+            any_event = any_event || !deletion_positions.empty();
+            stage++;
+        }
+
+        // insertions are drawn after the bases that remain after the deletions
+        arena::vector<int> insertion_positions(arena::resource());
+        arena::vector<int> insertion_length(arena::resource());
+        arena::vector<char> new_bases(arena::resource());
+        if (_insertion) {
+            insertion_positions = (use_hazard && !any_event) ? _get_stage_events(cumulative_hazard, stage, length, first_event) : get_event_positions(n_remaining, _insertion->rate);
+            if (!insertion_positions.empty()) {
+                insertion_length = _insertion->_draw_event_lengths(insertion_positions.size());
+                new_bases = _insertion->_draw_new_bases(std::accumulate(insertion_length.begin(), insertion_length.end(), 0));
+            }
+            any_event = any_event || !insertion_positions.empty();
+        }
+
+        // short-circuit if the length is unchanged
+        if (deletion_positions.empty() && insertion_positions.empty()) {
+            return any_event;
+        }
+
+        // assemble the oligo in a single pass into the destination, by copying the segments between the deletions and
+        // splitting them after each insertion position, which counts the remaining bases, the new bases are used
+        // starting from the last insertion
+        static thread_local std::vector<char> destination;
+        destination.resize(length + new_bases.size() + constants::SEGMENT_CHUNK_SIZE);
+        size_t write = 0;
+        size_t n_written = 0; // remaining bases written so far
+        size_t offset = new_bases.size();
+        size_t i_insertion = 0;
+        size_t deleted_end = 0;
+        for (size_t i_deletion = 0; i_deletion <= deletion_positions.size(); i_deletion++) {
+            size_t segment_end = (i_deletion < deletion_positions.size()) ? deletion_positions[i_deletion] : length;
+            if (segment_end >= deleted_end) {
+                size_t read = deleted_end;
+                while (i_insertion < insertion_positions.size() && (size_t)insertion_positions[i_insertion] < n_written + segment_end - read) {
+                    size_t split = read + insertion_positions[i_insertion] - n_written + 1;
+                    copy_segment(destination.data() + write, oligo.data() + read, split - read, length - read);
+                    write += split - read;
+                    n_written += split - read;
+                    read = split;
+                    offset -= insertion_length[i_insertion];
+                    copy_segment(destination.data() + write, new_bases.data() + offset, insertion_length[i_insertion], new_bases.size() - offset);
+                    write += insertion_length[i_insertion];
+                    i_insertion++;
+                }
+                copy_segment(destination.data() + write, oligo.data() + read, segment_end - read, length - read);
+                write += segment_end - read;
+                n_written += segment_end - read;
+                deleted_end = segment_end;
+            }
+            // make sure the deletion doesn't go past the end of the oligo
+            if (i_deletion < deletion_positions.size()) {
+                deleted_end = std::min(deleted_end + deletion_length[i_deletion], length);
+            }
+        }
+        destination.resize(write);
+        oligo.swap(destination);
+        return true;
+    }
+
+
+    // replace each run of adjacent substitution, deletion and insertion mutators in this order by a single error channel,
+    // runs of a single mutator are kept as they are
+    void fuse_error_channels(std::vector<std::unique_ptr<BaseMutator>> &mutators) {
+        std::vector<std::unique_ptr<BaseMutator>> fused;
+        size_t i = 0;
+        while (i < mutators.size()) {
+            size_t run_end = i;
+            if (run_end < mutators.size() && dynamic_cast<SubstitutionEvents*>(mutators[run_end].get())) {
+                run_end++;
+            }
+            if (run_end < mutators.size() && dynamic_cast<DeletionEvents*>(mutators[run_end].get())) {
+                run_end++;
+            }
+            if (run_end < mutators.size() && dynamic_cast<InsertionEvents*>(mutators[run_end].get())) {
+                run_end++;
+            }
+            if (run_end - i < 2) {
+                fused.push_back(std::move(mutators[i]));
+                i++;
+                continue;
+            }
+
+            std::unique_ptr<SubstitutionEvents> substitution;
+            std::unique_ptr<DeletionEvents> deletion;
+            std::unique_ptr<InsertionEvents> insertion;
+            for (; i < run_end; i++) {
+                if (dynamic_cast<SubstitutionEvents*>(mutators[i].get())) {
+                    substitution.reset(static_cast<SubstitutionEvents*>(mutators[i].release()));
+                } else if (dynamic_cast<DeletionEvents*>(mutators[i].get())) {
+                    deletion.reset(static_cast<DeletionEvents*>(mutators[i].release()));
+                } else {
+                    insertion.reset(static_cast<InsertionEvents*>(mutators[i].release()));
+                }
+            }
+            fused.push_back(std::make_unique<ErrorChannel>(std::move(substitution), std::move(deletion), std::move(insertion)));
+        }
+        mutators.swap(fused);
+    }
+
+
+
     //
     // BREAKAGE EVENTS
     //
@@ -357,20 +792,37 @@ namespace mutator {
         }
         this->p_base_preference = p_base_preference;
         normalize_vector(this->p_base_preference);
+
+        // get the probability of an event at each base type, 4 is to go from probability to rate
+        this->_p_event_by_base = std::vector<float>(4, 0.0);
+        for (int i = 0; i < 4; i++) {
+            this->_p_event_by_base[i] = std::min(4 * rate * this->p_base_preference[i], 1.0f);
+        }
+        this->_p_event_by_complement = std::vector<float>(this->_p_event_by_base.rbegin(), this->_p_event_by_base.rend());
     }
 
     // handles the breakage of a random base at a random position in the oligo
-    void BreakageEvents::process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) {
-        // get the positions of the breakage events, breaks are influenced by base type
-        std::vector<float> p_event_by_position(oligo.size(), 4 * rate); // 4 is to go from probability to rate
-        for (int i = 0; i < oligo.size(); i++) {
-            p_event_by_position[i] *= p_base_preference[oligo[i] - 1];
+    void BreakageEvents::process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) {
+        arena::vector<OligoView> fragments(arena::resource());
+        _process_view(OligoView{std::span<char>(oligo)}, fragments);
+        for (OligoView fragment : fragments) {
+            new_oligos.push_back(fragment.bases.data(), fragment.size());
         }
-        std::vector<int> event_positions = get_event_positions(p_event_by_position);
+    }
+
+    // handles the breakage of all oligos of a batch, whose fragments remain views of their bases
+    void BreakageEvents::process_batch(oligobatch::OligoBatch &oligos) {
+        process_batch_as_views(*this, oligos);
+    }
+
+    // splits an oligo into views of its fragments
+    void BreakageEvents::_process_view(OligoView oligo, arena::vector<OligoView> &fragments) {
+        // get the positions of the breakage events along the strand
+        arena::vector<int> event_positions = _get_break_positions(oligo);
 
         // short-circuit if there are no events
         if (event_positions.size() == 0) {
-            new_oligos.push_back(oligo);
+            fragments.push_back(oligo);
             return;
         }
         
@@ -383,15 +835,29 @@ namespace mutator {
                 last_pos = pos + 1;
                 continue;
             }
-            new_oligos.push_back(std::vector<char>(oligo.begin() + last_pos, oligo.begin() + pos));
+            fragments.push_back(oligo.subview(last_pos, pos - last_pos));
             last_pos = pos + 1;
         }
         // save the last fragment
         if (last_pos < oligo.size()) {
-            new_oligos.push_back(std::vector<char>(oligo.begin() + last_pos, oligo.end()));
+            fragments.push_back(oligo.subview(last_pos, oligo.size() - last_pos));
         }
     }
 
+    // get the positions of the breakage events along the strand of an oligo, breaks are influenced by base type
+    // the positions on the reverse strand are drawn over its bases as stored, with the probabilities of their complements
+    arena::vector<int> BreakageEvents::_get_break_positions(OligoView oligo) {
+        if (!oligo.reverse) {
+            return get_event_positions(oligo.bases, _p_event_by_base);
+        }
+        arena::vector<int> event_positions = get_event_positions(oligo.bases, _p_event_by_complement);
+        std::reverse(event_positions.begin(), event_positions.end());
+        for (int &pos : event_positions) {
+            pos = oligo.size() - 1 - pos;
+        }
+        return event_positions;
+    }
+
 
 
     //
@@ -406,7 +872,21 @@ namespace mutator {
     }
 
     // handles the size selection of a single oligo
-    void SizeSelection::process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) {
+    void SizeSelection::process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) {
+        arena::vector<OligoView> selected(arena::resource());
+        _process_view(OligoView{std::span<char>(oligo)}, selected);
+        if (!selected.empty()) {
+            new_oligos.push_back(oligo);
+        }
+    }
+
+    // handles the size selection of all oligos of a batch, without copying the selected ones
+    void SizeSelection::process_batch(oligobatch::OligoBatch &oligos) {
+        process_batch_as_views(*this, oligos);
+    }
+
+    // keeps the view of an oligo if it is selected
+    void SizeSelection::_process_view(OligoView oligo, arena::vector<OligoView> &selected) {
         // get the size of the oligo
         int size = oligo.size();
 
@@ -415,7 +895,7 @@ namespace mutator {
             return;
         }
         if (size >= upper_threshold) {
-            new_oligos.push_back(oligo);
+            selected.push_back(oligo);
             return;
         }
 
@@ -424,7 +904,49 @@ namespace mutator {
 
         // test if this oligo will be selected
         if (rng::random_float() < p_select) {
-            new_oligos.push_back(oligo);
+            selected.push_back(oligo);
+        }
+    }
+
+
+
+    //
+    // BREAKAGE SELECTION
+    //
+
+    // constructor for the BreakageSelection class, which takes over the mutators it combines
+    BreakageSelection::BreakageSelection(BreakageEvents breakage, SizeSelection selection) : _breakage(std::move(breakage)), _selection(std::move(selection)) {
+    }
+
+    // handles the breakage and size selection of a single oligo
+    void BreakageSelection::process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) {
+        arena::vector<OligoView> selected(arena::resource());
+        _process_view(OligoView{std::span<char>(oligo)}, selected);
+        for (OligoView fragment : selected) {
+            new_oligos.push_back(fragment.bases.data(), fragment.size());
+        }
+    }
+
+    // handles the breakage and size selection of all oligos of a batch, whose selected fragments remain views of their bases
+    void BreakageSelection::process_batch(oligobatch::OligoBatch &oligos) {
+        process_batch_as_views(*this, oligos);
+    }
+
+    // splits an oligo into fragments and keeps the views of the selected ones
+    void BreakageSelection::_process_view(OligoView oligo, arena::vector<OligoView> &selected) {
+        // get the positions of the breakage events along the strand
+        arena::vector<int> event_positions = _breakage._get_break_positions(oligo);
+
+        // select each fragment as soon as its end is known, skipping empty ones between adjacent breaks
+        int last_pos = 0;
+        for (int pos : event_positions) {
+            if (pos > last_pos) {
+                _selection._process_view(oligo.subview(last_pos, pos - last_pos), selected);
+            }
+            last_pos = pos + 1;
+        }
+        if ((size_t)last_pos < oligo.size()) {
+            _selection._process_view(oligo.subview(last_pos, oligo.size() - last_pos), selected);
         }
     }
 
@@ -438,13 +960,22 @@ namespace mutator {
     AddReverseComplement::AddReverseComplement() {
     }
 
-    // handles the addition of the reverse complement of a single oligo
-    void AddReverseComplement::process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) {
-        // add the oligo to the new oligos
+    // handles the addition of the reverse complement of a single oligo, as the reverse strand of the same bases
+    void AddReverseComplement::process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) {
         new_oligos.push_back(oligo);
+        new_oligos.push_reverse(new_oligos.size() - 1);
+    }
+
+    // handles the addition of the reverse complements of all oligos of a batch, by adding the reverse strand of each 
+    // oligo next to it without copying any base
+    void AddReverseComplement::process_batch(oligobatch::OligoBatch &oligos) {
+        process_batch_as_views(*this, oligos);
+    }
 
-        // add the reverse complement to the new oligos
-        new_oligos.push_back(conversion::reverse_complement(oligo));
+    // adds the reverse strand of an oligo as a view of the same bases, which is only complemented once it is copied
+    void AddReverseComplement::_process_view(OligoView oligo, arena::vector<OligoView> &strands) {
+        strands.push_back(oligo);
+        strands.push_back(OligoView{oligo.bases, !oligo.reverse});
     }
 
 
@@ -467,10 +998,10 @@ namespace mutator {
 
         // initialize the length and base samplers
         std::vector<float> p_tail_lengths(n_max - n_min + 1, 1.0);
-        this->_length_sampler = std::discrete_distribution<>(p_tail_lengths.begin(), p_tail_lengths.end());
+        this->_length_sampler = sampler::AliasSampler(p_tail_lengths.begin(), p_tail_lengths.end());
 
         std::vector<float> p_base_preference(this->_tail_bases.size(), 1.0);
-        this->_base_sampler = std::discrete_distribution<>(p_base_preference.begin(), p_base_preference.end());
+        this->_base_sampler = sampler::AliasSampler(p_base_preference.begin(), p_base_preference.end());
     }
 
     // handles the tailing of a single oligo
@@ -479,7 +1010,7 @@ namespace mutator {
         int length = _tail_lengths[_length_sampler(rng::rng)];
 
         // get the bases of the tail
-        std::vector<char> tail(length, 1);
+        arena::vector<char> tail(length, 1, arena::resource());
         draw_from_distribution(tail, _base_sampler);
         for (char &base : tail) {
             base = _tail_bases[base];
@@ -502,24 +1033,37 @@ namespace mutator {
         normalize_vector(this->p_removal_length);
 
         // initialize the length and base samplers
-        this->_length_sampler = std::discrete_distribution<>(this->p_removal_length.begin(), this->p_removal_length.end());
+        this->_length_sampler = sampler::AliasSampler(this->p_removal_length.begin(), this->p_removal_length.end());
     }
 
     // handles the shredded ends of a single oligo
     void EndShreds::process_single(std::vector<char> &oligo) {
         // get the length to cut
-        std::vector<int> lengths(2, 0);
+        int lengths[2] = {0, 0};
         draw_from_distribution(lengths, _length_sampler);
 
-        // remove the last bases from the oligo
-        if (lengths[0] > 0) {
-            oligo.resize(oligo.size() - lengths[0]);
-        }
+        // remove the last bases, then the first bases from the oligo, at most all of its bases
+        size_t end = oligo.size() - std::min((size_t)lengths[0], oligo.size());
+        size_t start = std::min((size_t)lengths[1], end);
+        oligo.resize(end);
+        oligo.erase(oligo.begin(), oligo.begin() + start);
+    }
 
-        // remove the first bases from the oligo
-        if (lengths[1] > 0) {
-            oligo.erase(oligo.begin(), oligo.begin() + lengths[1]);
-        }
+    // handles the shredded ends of all oligos of a batch, by narrowing each oligo instead of moving its bases
+    void EndShreds::process_batch(oligobatch::OligoBatch &oligos) {
+        process_batch_as_views(*this, oligos);
+    }
+
+    // narrows the view of an oligo to the bases left after removing its ends
+    void EndShreds::_process_view(OligoView oligo, arena::vector<OligoView> &shredded) {
+        // get the length to cut
+        int lengths[2] = {0, 0};
+        draw_from_distribution(lengths, _length_sampler);
+
+        // remove the last bases, then the first bases from the oligo
+        size_t end = oligo.size() - std::min((size_t)lengths[0], oligo.size());
+        size_t start = std::min((size_t)lengths[1], end);
+        shredded.push_back(oligo.subview(start, end - start));
     }
 
 
@@ -553,7 +1097,7 @@ namespace mutator {
 
         // initialize the base sampler
         std::vector<float> p_base_preference(4, 1.0);
-        this->_base_sampler = std::discrete_distribution<>(p_base_preference.begin(), p_base_preference.end());
+        this->_base_sampler = sampler::AliasSampler(p_base_preference.begin(), p_base_preference.end());
     }
 
     // handles the adapter addition to a single oligo
@@ -563,7 +1107,7 @@ namespace mutator {
 
         // pad the oligo if it is shorter than the read length
         if (length < read_length) {
-            std::vector<char> padding(read_length - length, 1);
+            arena::vector<char> padding(read_length - length, 1, arena::resource());
             draw_from_distribution(padding, _base_sampler);
             for (char &base : padding) {
                 base += 1;
@@ -3,26 +3,89 @@
 
 #include <vector>
 #include <random>
+#include <span>
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <cstdint>
+
+#include "sampler.hpp"
+#include "oligobatch.hpp"
+#include "conversion.hpp"
+#include "arena.hpp"
 
 
 namespace mutator {
 
+    template <typename... Mutators>
+    class MutatorChain;
+
+    class BreakageSelection;
+
+    // view of the bases of an oligo, which is read as their reverse complement if reverse is set, such that the reverse
+    // strand of an oligo does not have to be copied before it is cut, positions are counted along the strand
+    struct OligoView {
+        std::span<char> bases;
+        bool reverse = false;
+
+        size_t size() const { return bases.size(); }
+
+        // the view of #length bases from #start onwards along the strand
+        OligoView subview(size_t start, size_t length) const {
+            if (reverse) {
+                return {bases.subspan(bases.size() - start - length, length), true};
+            }
+            return {bases.subspan(start, length), false};
+        }
+    };
+
     class BaseMutator {
         private:
             std::string name = "BaseMutator";
             bool manipulates_count = false;
-            virtual void process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos);
+            static inline std::atomic<uint64_t> _next_instance = 0;
+            virtual void process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos);
             virtual void process_single(std::vector<char> &oligo);
 
+            template <typename... Mutators>
+            friend class MutatorChain;
+
         public:
+            // identifies the mutator among all mutators created, such that tables computed for it are not reused for another one
+            const uint64_t instance = _next_instance++;
+
+            virtual ~BaseMutator() = default;
+
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
-            virtual void process(std::vector<std::vector<char>> &oligos);
+
+            // process all oligos of a batch, such as the oligos of many design sequences at once, replacing them by the
+            // resulting oligos, by default each oligo is processed on its own
+            virtual void process_batch(oligobatch::OligoBatch &oligos);
+
+            // process a single oligo in place, for mutators that do not change the number of oligos
+            void process(std::vector<char> &oligo);
             void normalize_vector(std::vector<float> &vec);
             bool is_mutation(float probability);
-            std::vector<int> get_event_positions(std::vector<float>const &p_event_by_position);
-            void draw_from_distribution(std::vector<int> &draws, std::discrete_distribution<> &sampler);
-            void draw_from_distribution(std::vector<char> &draws, std::discrete_distribution<> &sampler);
+            int draw_gap(double log_p_no_event);
+            arena::vector<int> get_event_positions(int length, float probability);
+            arena::vector<int> get_event_positions(std::span<const char> oligo, std::vector<float> const &p_event_by_base);
+            void keep_events_by_base(std::span<const char> oligo, arena::vector<int> &event_positions, std::vector<float> const &p_event_by_base, float p_max);
+            arena::vector<int> get_event_positions(std::span<const double> cumulative_hazard, int start = 0);
+            void draw_from_distribution(std::span<int> draws, const sampler::AliasSampler &sampler);
+            void draw_from_distribution(std::span<char> draws, const sampler::AliasSampler &sampler);
+
+            // probability of an event at each event slot of an unmodified oligo, for mutators whose events occur independently
+            // at each slot without changing the number of oligos, returns false for all other mutators
+            // the slots are the positions of the oligo, one after another for each stage of a mutator with several stages
+            virtual bool get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const;
+
+            // process an unmodified oligo with events drawn from the cumulative hazard of its event probabilities, given that
+            // the first event occurs at slot first_event if it is not negative, for mutators that provide event probabilities
+            // returns false if no event occurred, such that the oligo is still unmodified
+            virtual bool process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event = -1);
     };
 
 
@@ -32,14 +95,23 @@ namespace mutator {
             std::string name = "InsertionEvents";
             bool manipulates_count = false;
             bool _custom_event_lengths = false;
-            std::discrete_distribution<> _event_lengths_sampler;
-            std::discrete_distribution<> _base_sampler;
+            sampler::AliasSampler _event_lengths_sampler;
+            sampler::AliasSampler _base_sampler;
 
             virtual void process_single(std::vector<char> &oligo) override;
+            arena::vector<int> _draw_event_lengths(size_t n_events);
+            arena::vector<char> _draw_new_bases(int n_bases);
+            void _apply_events(std::vector<char> &oligo, arena::vector<int> const &event_positions);
+
+            friend class ErrorChannel;
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual bool get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const override;
+            virtual bool process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event = -1) override;
             float rate = 0.0;
             std::vector<float> p_event_lengths;
             std::vector<float> p_base_preference;
@@ -53,13 +125,23 @@ namespace mutator {
             std::string name = "DeletionEvents";
             bool manipulates_count = false;
             bool _custom_event_lengths = false;
-            std::discrete_distribution<> _event_lengths_sampler;
+            sampler::AliasSampler _event_lengths_sampler;
 
             virtual void process_single(std::vector<char> &oligo) override;
+            arena::vector<int> _draw_event_lengths(size_t n_events);
+            void _apply_events(std::vector<char> &oligo, arena::vector<int> const &event_positions);
+
+            std::vector<float> _p_event_by_base;
+
+            friend class ErrorChannel;
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual bool get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const override;
+            virtual bool process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event = -1) override;
             float rate = 0.0;
             std::vector<float> p_event_lengths;
             std::vector<float> p_base_preference;
@@ -73,14 +155,24 @@ namespace mutator {
             std::string name = "SubstitutionEvents";
             bool manipulates_count = false;
             bool _custom_event_lengths = false;
-            std::discrete_distribution<> _event_lengths_sampler;
-            std::vector<std::discrete_distribution<>> _base_sampler;
+            sampler::AliasSampler _event_lengths_sampler;
+            std::vector<sampler::AliasSampler> _base_sampler;
 
             virtual void process_single(std::vector<char> &oligo) override;
+            void _apply_events(std::span<char> oligo, arena::vector<int> const &event_positions);
+
+            std::vector<float> _p_event_by_base;
+
+            friend class ErrorChannel;
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override;
+            virtual bool get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const override;
+            virtual bool process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event = -1) override;
             float rate = 0.0;
             std::vector<float> p_event_lengths;
             std::vector<float> p_base_preference;
@@ -89,18 +181,57 @@ namespace mutator {
     };
 
 
+    // substitutions, deletions and insertions applied one after another as a single mutator, which edits the oligo in a
+    // single pass into one buffer instead of rewriting it for each of them, any of the three may be missing
+    class ErrorChannel : public BaseMutator {
+        private:
+            std::string name = "ErrorChannel";
+            bool manipulates_count = false;
+            std::unique_ptr<SubstitutionEvents> _substitution;
+            std::unique_ptr<DeletionEvents> _deletion;
+            std::unique_ptr<InsertionEvents> _insertion;
+
+            virtual void process_single(std::vector<char> &oligo) override;
+            arena::vector<int> _get_stage_events(std::span<const double> cumulative_hazard, int stage, int length, int first_event);
+            bool _apply_stages(std::vector<char> &oligo, std::span<const double> cumulative_hazard, int first_event);
+
+            template <typename... Mutators>
+            friend class MutatorChain;
+
+        public:
+            virtual std::string get_name() const { return name; }
+            virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual bool get_event_probabilities(std::vector<char> const &oligo, arena::vector<double> &p_event) const override;
+            virtual bool process_single_with_hazard(std::vector<char> &oligo, std::vector<double> const &cumulative_hazard, int first_event = -1) override;
+
+            ErrorChannel(std::unique_ptr<SubstitutionEvents> substitution, std::unique_ptr<DeletionEvents> deletion, std::unique_ptr<InsertionEvents> insertion);
+    };
+
+
     class BreakageEvents : public BaseMutator {
         private:
             std::string name = "BreakageEvents";
             bool manipulates_count = true;
             std::vector<char> _adapter_vector;
-            std::discrete_distribution<> _base_sampler;
+            sampler::AliasSampler _base_sampler;
+
+            virtual void process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) override;
+            void _process_view(OligoView oligo, arena::vector<OligoView> &fragments);
+            arena::vector<int> _get_break_positions(OligoView oligo);
+
+            std::vector<float> _p_event_by_base;
+            std::vector<float> _p_event_by_complement; // probability of an event at each base type read on the reverse strand
 
-            virtual void process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) override;
+            friend class BreakageSelection;
+            template <typename Mutator>
+            friend void process_batch_as_views(Mutator &mutator, oligobatch::OligoBatch &oligos);
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override;
             float rate = 0.0;
             std::vector<float> p_base_preference;
 
@@ -112,11 +243,19 @@ namespace mutator {
         private:
             std::string name = "SizeSelection";
             bool manipulates_count = true;
-            virtual void process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) override;
+            virtual void process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) override;
+            void _process_view(OligoView oligo, arena::vector<OligoView> &selected);
+
+            friend class BreakageSelection;
+            template <typename Mutator>
+            friend void process_batch_as_views(Mutator &mutator, oligobatch::OligoBatch &oligos);
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override;
             int lower_cutoff;
             int upper_threshold;
 
@@ -124,15 +263,48 @@ namespace mutator {
     };
 
 
+    // breakage followed by size selection as a single mutator, which decides on each fragment as soon as it is cut off,
+    // such that the fragments are never collected before the selection, the random draws are those of both mutators
+    class BreakageSelection : public BaseMutator {
+        private:
+            std::string name = "BreakageSelection";
+            bool manipulates_count = true;
+            BreakageEvents _breakage;
+            SizeSelection _selection;
+
+            virtual void process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) override;
+            void _process_view(OligoView oligo, arena::vector<OligoView> &selected);
+
+            template <typename Mutator>
+            friend void process_batch_as_views(Mutator &mutator, oligobatch::OligoBatch &oligos);
+            template <typename... Mutators>
+            friend class MutatorChain;
+
+        public:
+            virtual std::string get_name() const { return name; }
+            virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override;
+
+            BreakageSelection(BreakageEvents breakage, SizeSelection selection);
+    };
+
+
     class AddReverseComplement : public BaseMutator {
         private:
             std::string name = "AddReverseComplement";
             bool manipulates_count = true;
-            virtual void process_single_with_new(std::vector<char> &oligo, std::vector<std::vector<char>> &new_oligos) override;
+            virtual void process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) override;
+            void _process_view(OligoView oligo, arena::vector<OligoView> &strands);
+
+            template <typename Mutator>
+            friend void process_batch_as_views(Mutator &mutator, oligobatch::OligoBatch &oligos);
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override;
 
             AddReverseComplement();
     };
@@ -145,11 +317,14 @@ namespace mutator {
             std::vector<char> _adapter_vector;
             std::vector<char> _tail_bases;
             std::vector<int> _tail_lengths;
-            std::discrete_distribution<> _base_sampler;
-            std::discrete_distribution<> _length_sampler;
+            sampler::AliasSampler _base_sampler;
+            sampler::AliasSampler _length_sampler;
 
             virtual void process_single(std::vector<char> &oligo) override;
 
+            template <typename... Mutators>
+            friend class MutatorChain;
+
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
@@ -163,13 +338,20 @@ namespace mutator {
         private:
             std::string name = "EndShreds";
             bool manipulates_count = false;
-            std::discrete_distribution<> _length_sampler;
+            sampler::AliasSampler _length_sampler;
 
             virtual void process_single(std::vector<char> &oligo) override;
+            void _process_view(OligoView oligo, arena::vector<OligoView> &shredded);
+
+            template <typename Mutator>
+            friend void process_batch_as_views(Mutator &mutator, oligobatch::OligoBatch &oligos);
+            template <typename... Mutators>
+            friend class MutatorChain;
 
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override;
             std::vector<float> p_removal_length;
             EndShreds(std::vector<float> p_removal_lengths);
     };
@@ -183,6 +365,9 @@ namespace mutator {
 
             virtual void process_single(std::vector<char> &oligo) override;
 
+            template <typename... Mutators>
+            friend class MutatorChain;
+
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
@@ -194,10 +379,13 @@ namespace mutator {
         private:
             std::string name = "SequencingPadTrim";
             bool manipulates_count = false;
-            std::discrete_distribution<> _base_sampler;
+            sampler::AliasSampler _base_sampler;
 
             virtual void process_single(std::vector<char> &oligo) override;
 
+            template <typename... Mutators>
+            friend class MutatorChain;
+
         public:
             virtual std::string get_name() const { return name; }
             virtual bool get_manipulates_count() const { return manipulates_count; }
@@ -205,6 +393,171 @@ namespace mutator {
             SequencingPadTrim(int read_length);
     };
 
+
+
+    // mutators applied one after another as a single mutator, with their types fixed at compile time such that their
+    // calls are bound statically, each oligo passes through all of them before the next oligo is processed, unless a
+    // whole batch is processed by a chain that does not change the number of oligos, which hands it to each mutator that
+    // processes whole batches, and passes each oligo through the mutators in between in a single pass
+    // the fragments of mutators that only cut, drop or reverse oligos are passed on as views, and only the surviving ones are copied
+    template <typename... Mutators>
+    class MutatorChain : public BaseMutator {
+        private:
+            std::string name = "MutatorChain";
+            bool manipulates_count = false;
+            std::tuple<Mutators...> _mutators;
+
+            virtual void process_single(std::vector<char> &oligo) override {
+                _apply<0>(oligo);
+            }
+            virtual void process_single_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) override {
+                _apply_with_new<0>(oligo, new_oligos);
+            }
+
+            // apply the mutators from #I onwards in place, for chains that do not change the number of oligos
+            template <size_t I>
+            void _apply(std::vector<char> &oligo) {
+                if constexpr (I < sizeof...(Mutators)) {
+                    using Mutator = std::tuple_element_t<I, std::tuple<Mutators...>>;
+                    std::get<I>(_mutators).Mutator::process_single(oligo);
+                    _apply<I + 1>(oligo);
+                }
+            }
+
+            // apply the mutators from #I onwards and add the resulting oligos to the new oligos, the oligos created by a
+            // mutator are each passed through the remaining ones in a batch kept by the thread for this position
+            template <size_t I>
+            void _apply_with_new(std::vector<char> &oligo, oligobatch::OligoBatch &new_oligos) {
+                if constexpr (I == sizeof...(Mutators)) {
+                    new_oligos.push_back(oligo);
+                } else {
+                    using Mutator = std::tuple_element_t<I, std::tuple<Mutators...>>;
+                    Mutator &mutator = std::get<I>(_mutators);
+                    if (!mutator.Mutator::get_manipulates_count()) {
+                        mutator.Mutator::process_single(oligo);
+                        _apply_with_new<I + 1>(oligo, new_oligos);
+                        return;
+                    }
+                    if constexpr (_processes_views<Mutator>) {
+                        _apply_to_view<I>(OligoView{std::span<char>(oligo)}, new_oligos);
+                        return;
+                    }
+                    static thread_local oligobatch::OligoBatch created_oligos;
+                    static thread_local std::vector<char> created_oligo;
+                    created_oligos.clear();
+                    mutator.Mutator::process_single_with_new(oligo, created_oligos);
+                    for (size_t i = 0; i < created_oligos.size(); i++) {
+                        created_oligos.get(i, created_oligo);
+                        _apply_with_new<I + 1>(created_oligo, new_oligos);
+                    }
+                }
+            }
+
+            // whether a mutator only cuts, drops or reverses oligos, such that its resulting oligos can be views of their bases
+            template <typename Mutator>
+            static constexpr bool _processes_views = requires (Mutator &mutator, OligoView oligo, arena::vector<OligoView> &views) {
+                mutator._process_view(oligo, views);
+            };
+
+            // apply the mutators from #I onwards to a view of the bases of an oligo, which is passed on as views as long as 
+            // the mutators only cut, drop or reverse it, and only copied into a buffer for the first mutator that edits its
+            // bases, the reverse strand is complemented when it is copied into that buffer, and otherwise added with its strand
+            template <size_t I>
+            void _apply_to_view(OligoView oligo, oligobatch::OligoBatch &new_oligos) {
+                if constexpr (I == sizeof...(Mutators)) {
+                    new_oligos.push_back(oligo.bases.data(), oligo.size(), oligo.reverse);
+                } else {
+                    using Mutator = std::tuple_element_t<I, std::tuple<Mutators...>>;
+                    if constexpr (_processes_views<Mutator>) {
+                        arena::vector<OligoView> views(arena::resource());
+                        std::get<I>(_mutators)._process_view(oligo, views);
+                        for (OligoView view : views) {
+                            _apply_to_view<I + 1>(view, new_oligos);
+                        }
+                    } else {
+                        static thread_local std::vector<char> viewed_oligo;
+                        viewed_oligo.assign(oligo.bases.begin(), oligo.bases.end());
+                        if (oligo.reverse) {
+                            conversion::reverse_complement_in_place(viewed_oligo.data(), viewed_oligo.size());
+                        }
+                        _apply_with_new<I>(viewed_oligo, new_oligos);
+                    }
+                }
+            }
+
+            // whether a mutator processes whole batches by itself, instead of one oligo after another as the base class does
+            template <typename Mutator>
+            static constexpr bool _processes_batches = !std::is_same_v<decltype(&Mutator::process_batch), void (BaseMutator::*)(oligobatch::OligoBatch &)>;
+
+            // the first mutator from #I onwards that processes whole batches, or the end of the chain
+            template <size_t I>
+            static constexpr size_t _next_batch_mutator() {
+                if constexpr (I == sizeof...(Mutators)) {
+                    return I;
+                } else if constexpr (_processes_batches<std::tuple_element_t<I, std::tuple<Mutators...>>>) {
+                    return I;
+                } else {
+                    return _next_batch_mutator<I + 1>();
+                }
+            }
+
+            // apply the mutators from #I up to #J in place
+            template <size_t I, size_t J>
+            void _apply_range(std::vector<char> &oligo) {
+                if constexpr (I < J) {
+                    using Mutator = std::tuple_element_t<I, std::tuple<Mutators...>>;
+                    std::get<I>(_mutators).Mutator::process_single(oligo);
+                    _apply_range<I + 1, J>(oligo);
+                }
+            }
+
+            // apply the mutators from #I onwards to a whole batch, a mutator that processes whole batches gets the batch, 
+            // while each oligo is copied once into a buffer kept by the thread and passed through all mutators up to the 
+            // next one of those, and stored in a new batch kept by the thread for this position
+            template <size_t I>
+            void _apply_batch(oligobatch::OligoBatch &oligos) {
+                if constexpr (I < sizeof...(Mutators)) {
+                    using Mutator = std::tuple_element_t<I, std::tuple<Mutators...>>;
+                    if constexpr (_processes_batches<Mutator>) {
+                        std::get<I>(_mutators).Mutator::process_batch(oligos);
+                        _apply_batch<I + 1>(oligos);
+                    } else {
+                        constexpr size_t J = _next_batch_mutator<I>();
+                        static thread_local std::vector<char> oligo;
+                        static thread_local oligobatch::OligoBatch new_oligos;
+                        new_oligos.clear();
+                        for (size_t i = 0; i < oligos.size(); i++) {
+                            oligos.get(i, oligo);
+                            _apply_range<I, J>(oligo);
+                            new_oligos.push_back(oligo);
+                        }
+                        oligos.swap(new_oligos);
+                        _apply_batch<J>(oligos);
+                    }
+                }
+            }
+
+        public:
+            virtual std::string get_name() const { return name; }
+            virtual bool get_manipulates_count() const { return manipulates_count; }
+
+            virtual void process_batch(oligobatch::OligoBatch &oligos) override {
+                if (manipulates_count) {
+                    BaseMutator::process_batch(oligos);
+                    return;
+                }
+                _apply_batch<0>(oligos);
+            }
+
+            MutatorChain(Mutators... mutators) : _mutators(std::move(mutators)...) {
+                this->manipulates_count = std::apply([](Mutators const &... mutator) { return (mutator.get_manipulates_count() || ...); }, _mutators);
+            }
+    };
+
+
+    // replace each run of adjacent substitution, deletion and insertion mutators in this order by a single error channel
+    void fuse_error_channels(std::vector<std::unique_ptr<BaseMutator>> &mutators);
+
 } // namespace mutators
 
 #endif // MUTATOR_HPP
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <cstring>
+
+#include "oligobatch.hpp"
+#include "conversion.hpp"
+
+
+namespace oligobatch {
+
+    static std::atomic<uint64_t> _allocations = 0;
+
+
+    // count the buffers that have to grow to hold n_oligos more oligos with n_bases more bases
+    void OligoBatch::_count_growth(size_t n_oligos, size_t n_bases) {
+        if (_offsets.size() + n_oligos > _offsets.capacity()) {
+            _allocations += 3;
+        }
+        if (_bases.size() + n_bases > _bases.capacity()) {
+            _allocations++;
+        }
+    }
+
+    // copy oligo #i into a sequence vector, complemented if it is a reverse strand
+    void OligoBatch::get(size_t i, std::vector<char>& sequence_vector) const {
+        if (_reverse[i]) {
+            sequence_vector.resize(_lengths[i]);
+            conversion::reverse_complement_copy(data(i), _lengths[i], sequence_vector.data());
+            return;
+        }
+        sequence_vector.assign(data(i), data(i) + _lengths[i]);
+    }
+
+    // remove all oligos, keeping the allocated space
+    void OligoBatch::clear() {
+        _bases.clear();
+        _offsets.clear();
+        _lengths.clear();
+        _reverse.clear();
+        _n_reverse = 0;
+        _n_gap_bases = 0;
+        _in_order = true;
+    }
+
+    // reserve space for n_oligos oligos with n_bases bases, a buffer that has to grow at least doubles, such that batches 
+    // whose buffers are reused for slightly more oligos each time do not grow on every use
+    void OligoBatch::reserve(size_t n_oligos, size_t n_bases) {
+        _count_growth(n_oligos - std::min(n_oligos, size()), n_bases - std::min(n_bases, _bases.size()));
+        if (n_bases > _bases.capacity()) {
+            _bases.reserve(std::max(n_bases, 2 * _bases.capacity()));
+        }
+        if (n_oligos > _offsets.capacity()) {
+            _offsets.reserve(std::max(n_oligos, 2 * _offsets.capacity()));
+            _lengths.reserve(std::max(n_oligos, 2 * _lengths.capacity()));
+            _reverse.reserve(std::max(n_oligos, 2 * _reverse.capacity()));
+        }
+    }
+
+    // remove all oligos, and free the buffers if they have space for more than max_bases bases
+    void OligoBatch::release(size_t max_bases) {
+        clear();
+        if (_bases.capacity() <= max_bases) {
+            return;
+        }
+        std::vector<char>().swap(_bases);
+        std::vector<size_t>().swap(_offsets);
+        std::vector<size_t>().swap(_lengths);
+        std::vector<char>().swap(_reverse);
+    }
+
+    // add an oligo at the end, as the reverse strand of the bases if reverse is set, the bases must not be part of 
+    // this batch
+    void OligoBatch::push_back(const char* sequence, size_t length, bool reverse) {
+        _count_growth(1, length);
+        _offsets.push_back(_bases.size());
+        _lengths.push_back(length);
+        _reverse.push_back(reverse);
+        _n_reverse += reverse;
+        _bases.insert(_bases.end(), sequence, sequence + length);
+    }
+
+    // add the other strand of oligo #i at the end, as a view of the same bases
+    void OligoBatch::push_reverse(size_t i) {
+        _count_growth(1, 0);
+        _offsets.push_back(_offsets[i]);
+        _lengths.push_back(_lengths[i]);
+        _reverse.push_back(!_reverse[i]);
+        _n_reverse += _reverse.back();
+        _in_order = false;
+    }
+
+    // turn oligo #i into the other strand of its bases
+    void OligoBatch::flip(size_t i) {
+        _n_reverse += _reverse[i] ? -1 : 1;
+        _reverse[i] = !_reverse[i];
+    }
+
+    // turn all oligos into the other strand of their bases
+    void OligoBatch::flip() {
+        for (char& reverse : _reverse) {
+            reverse = !reverse;
+        }
+        _n_reverse = size() - _n_reverse;
+    }
+
+    // add n_copies copies of an oligo at the end
+    void OligoBatch::push_back(const std::vector<char>& sequence_vector, size_t n_copies) {
+        size_t length = sequence_vector.size();
+        reserve(_offsets.size() + n_copies, _bases.size() + n_copies * length);
+        for (size_t i = 0; i < n_copies; i++) {
+            _offsets.push_back(_bases.size());
+            _lengths.push_back(length);
+            _reverse.push_back(false);
+            _bases.insert(_bases.end(), sequence_vector.begin(), sequence_vector.end());
+        }
+    }
+
+    // add all oligos of another batch at the end, keeping their strands, only the bases of its oligos are copied one
+    // after another if its buffer has gaps or its oligos are not in order
+    void OligoBatch::append(const OligoBatch& other) {
+        _reverse.insert(_reverse.end(), other._reverse.begin(), other._reverse.end());
+        _n_reverse += other._n_reverse;
+        if (other._n_gap_bases > 0 || !other._in_order) {
+            _count_growth(other.size(), other.n_bases() - other._n_gap_bases);
+            for (size_t i = 0; i < other.size(); i++) {
+                _offsets.push_back(_bases.size());
+                _lengths.push_back(other._lengths[i]);
+                _bases.insert(_bases.end(), other.data(i), other.data(i) + other._lengths[i]);
+            }
+            return;
+        }
+        size_t shift = _bases.size();
+        _count_growth(other.size(), other.n_bases());
+        _bases.insert(_bases.end(), other._bases.begin(), other._bases.end());
+        for (size_t i = 0; i < other.size(); i++) {
+            _offsets.push_back(other._offsets[i] + shift);
+            _lengths.push_back(other._lengths[i]);
+        }
+    }
+
+    void OligoBatch::swap(OligoBatch& other) {
+        _bases.swap(other._bases);
+        _offsets.swap(other._offsets);
+        _lengths.swap(other._lengths);
+        _reverse.swap(other._reverse);
+        std::swap(_n_reverse, other._n_reverse);
+        std::swap(_n_gap_bases, other._n_gap_bases);
+        std::swap(_in_order, other._in_order);
+    }
+
+    // restrict oligo #i to #length of its bases from #start onwards, without moving any base
+    void OligoBatch::narrow(size_t i, size_t start, size_t length) {
+        if (_in_order) {
+            _n_gap_bases += _lengths[i] - length;
+        }
+        _offsets[i] += start;
+        _lengths[i] = length;
+    }
+
+    // replace the oligos by views of the buffer given by their offsets, lengths and strands, the vectors are exchanged
+    void OligoBatch::set_views(std::vector<size_t>& offsets, std::vector<size_t>& lengths, std::vector<char>& reverse) {
+        _offsets.swap(offsets);
+        _lengths.swap(lengths);
+        _reverse.swap(reverse);
+        _n_reverse = std::count(_reverse.begin(), _reverse.end(), true);
+
+        // the gaps are only counted while each oligo starts behind the end of the previous one
+        _in_order = true;
+        size_t end = 0;
+        for (size_t i = 0; i < _offsets.size() && _in_order; i++) {
+            _in_order = _offsets[i] >= end;
+            end = _offsets[i] + _lengths[i];
+        }
+        _n_gap_bases = _in_order ? _bases.size() - std::accumulate(_lengths.begin(), _lengths.end(), (size_t)0) : 0;
+    }
+
+    // copy the oligos such that all of them are forward strands lying one after another without any gap, the copies 
+    // are made in a batch kept by the thread, which exchanges its buffers with this batch
+    void OligoBatch::normalize() {
+        if (_in_order && _n_reverse == 0 && _n_gap_bases == 0) {
+            return;
+        }
+        static thread_local OligoBatch normalized;
+        normalized.clear();
+        normalized.reserve(size(), _in_order ? _bases.size() - _n_gap_bases : std::accumulate(_lengths.begin(), _lengths.end(), (size_t)0));
+        for (size_t i = 0; i < size(); i++) {
+            normalized._count_growth(1, _lengths[i]);
+            normalized._offsets.push_back(normalized._bases.size());
+            normalized._lengths.push_back(_lengths[i]);
+            normalized._reverse.push_back(false);
+            normalized._bases.resize(normalized._bases.size() + _lengths[i]);
+            if (_reverse[i]) {
+                conversion::reverse_complement_copy(data(i), _lengths[i], normalized._bases.data() + normalized._offsets[i]);
+            } else {
+                std::memcpy(normalized._bases.data() + normalized._offsets[i], data(i), _lengths[i]);
+            }
+        }
+        swap(normalized);
+    }
+
+
+    // number of times the buffers of any batch have been allocated or grown
+    uint64_t count_allocations() {
+        return _allocations;
+    }
+
+} // namespace oligobatch
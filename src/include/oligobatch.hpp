@@ -0,0 +1,105 @@
+#ifndef OLIGOBATCH_HPP
+#define OLIGOBATCH_HPP
+
+#include <vector>
+#include <string_view>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace oligobatch {
+
+    // set of oligos stored one after another in a single buffer, with the offset and length of each oligo
+    // each oligo is a view of its bases in the buffer, which can be narrowed or split without moving any base, 
+    // such that the buffer may hold gaps of bases outside of any oligo
+    // each oligo is either the forward strand of its bases, or their reverse strand, which is read as the reverse 
+    // complement of the bases and only complemented once the oligo is copied, such that both strands of an oligo can
+    // share the same bases
+    class OligoBatch {
+        private:
+            std::vector<char> _bases;
+            std::vector<size_t> _offsets;
+            std::vector<size_t> _lengths;
+            std::vector<char> _reverse; // whether each oligo is the reverse strand of its bases
+            size_t _n_reverse = 0;
+            size_t _n_gap_bases = 0; // bases of the buffer outside of any oligo, only counted while the oligos are in order
+            bool _in_order = true; // whether the oligos lie one after another without overlapping
+
+            // count the buffers that have to grow to hold n_oligos more oligos with n_bases more bases
+            void _count_growth(size_t n_oligos, size_t n_bases);
+
+        public:
+            size_t size() const { return _offsets.size(); }
+            bool empty() const { return _offsets.empty(); }
+            size_t n_bases() const { return _bases.size(); }
+            size_t n_gap_bases() const { return _n_gap_bases; } // only counted while the oligos are in order
+
+            // access the bases of oligo #i as stored, which are read as their reverse complement if the oligo is a reverse
+            // strand, valid until the next oligo is added
+            const char* data(size_t i) const { return _bases.data() + _offsets[i]; }
+            char* data(size_t i) { return _bases.data() + _offsets[i]; }
+            size_t length(size_t i) const { return _lengths[i]; }
+            std::string_view view(size_t i) const { return std::string_view(data(i), _lengths[i]); }
+            bool reverse(size_t i) const { return _reverse[i]; }
+
+            size_t offset(size_t i) const { return _offsets[i]; }
+
+            // whether the oligos lie one after another without overlapping, and whether any of them is a reverse strand
+            bool in_order() const { return _in_order; }
+            bool has_reverse() const { return _n_reverse > 0; }
+
+            // access the whole buffer, in which the oligos lie one after another without overlapping if they are in order, 
+            // but possibly with gaps
+            std::span<char> bases() { return std::span<char>(_bases); }
+
+            // copy oligo #i into a sequence vector, complemented if it is a reverse strand
+            void get(size_t i, std::vector<char>& sequence_vector) const;
+
+            // remove all oligos, keeping the allocated space
+            void clear();
+
+            void reserve(size_t n_oligos, size_t n_bases);
+
+            // remove all oligos, and free the buffers if they have space for more than max_bases bases, such that a batch 
+            // kept for reuse does not hold on to the space of its largest use
+            void release(size_t max_bases);
+
+            // add an oligo at the end, as the reverse strand of the bases if reverse is set, the bases must not be part of 
+            // this batch
+            void push_back(const char* sequence, size_t length, bool reverse = false);
+            void push_back(const std::vector<char>& sequence_vector) { push_back(sequence_vector.data(), sequence_vector.size()); }
+
+            // add the other strand of oligo #i at the end, as a view of the same bases
+            void push_reverse(size_t i);
+
+            // turn oligo #i, or all oligos, into the other strand of their bases
+            void flip(size_t i);
+            void flip();
+
+            // add n_copies copies of an oligo at the end
+            void push_back(const std::vector<char>& sequence_vector, size_t n_copies);
+
+            // add all oligos of another batch at the end
+            void append(const OligoBatch& other);
+
+            void swap(OligoBatch& other);
+
+            // restrict oligo #i to #length of its bases from #start onwards, without moving any base
+            void narrow(size_t i, size_t start, size_t length);
+
+            // replace the oligos by views of the buffer given by their offsets, lengths and strands, the vectors are 
+            // exchanged with those of the previous oligos
+            void set_views(std::vector<size_t>& offsets, std::vector<size_t>& lengths, std::vector<char>& reverse);
+
+            // copy the oligos such that all of them are forward strands lying one after another without any gap
+            void normalize();
+    };
+
+    // number of times the buffers of any batch have been allocated or grown
+    uint64_t count_allocations();
+
+} // namespace oligobatch
+
+
+#endif // OLIGOBATCH_HPP
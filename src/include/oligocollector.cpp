@@ -1,10 +1,20 @@
 #include <vector>
+#include <span>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <string_view>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
 
 #include "oligocollector.hpp"
 #include "fileio.hpp"
 #include "conversion.hpp"
 #include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "arena.hpp"
+#include "constants.hpp"
 #include "logging.hpp"
 
 Logger logger("oligocollector", "INFO");
@@ -12,56 +22,336 @@ Logger logger("oligocollector", "INFO");
 
 namespace oligocollector {
 
+    void CollectedReads::clear() {
+        fw.clear();
+        rv.clear();
+        multiplicities.clear();
+    }
+
+    // add the reads of another set at the end, reads without a recorded multiplicity occur once
+    void CollectedReads::append(CollectedReads const& other) {
+        if (!multiplicities.empty() || !other.multiplicities.empty()) {
+            multiplicities.resize(fw.size(), 1);
+            multiplicities.insert(multiplicities.end(), other.multiplicities.begin(), other.multiplicities.end());
+            multiplicities.resize(fw.size() + other.fw.size(), 1);
+        }
+        fw.append(other.fw);
+        rv.append(other.rv);
+    }
+
     
     OligoCollector::OligoCollector(fileio::SequenceFileWriter& filewriter_fw) {
         this->filewriter_fw.reset(&filewriter_fw);
         _create_rv = false;
+        _start_writers();
     }
     
     OligoCollector::OligoCollector(fileio::SequenceFileWriter& filewriter_fw, fileio::SequenceFileWriter& filewriter_rv) {
         this->filewriter_fw.reset(&filewriter_fw);
         this->filewriter_rv.reset(&filewriter_rv);
         _create_rv = true;
+        _start_writers();
     }
 
     OligoCollector::~OligoCollector() {
+        // ensure the writer threads are stopped
+        try {
+            finish();
+        } catch (std::exception& e) {
+            logger.critical("An error occurred while writing the reads: {}", e.what());
+        }
+
         // clear all pointers
         filewriter_fw.release();
         filewriter_rv.release();
         _mutators.release();
     }
 
+    // start the writer threads for all output files
+    void OligoCollector::_start_writers() {
+        _queue_fw = std::make_unique<ReadQueue>(constants::WRITER_QUEUE_CAPACITY);
+        _writer_thread_fw = std::thread(&OligoCollector::_writer_loop, this, std::ref(*_queue_fw), std::ref(*filewriter_fw));
+        if (_create_rv) {
+            _queue_rv = std::make_unique<ReadQueue>(constants::WRITER_QUEUE_CAPACITY);
+            _writer_thread_rv = std::thread(&OligoCollector::_writer_loop, this, std::ref(*_queue_rv), std::ref(*filewriter_rv));
+        }
+    }
+
+    // write all read batches from the queue to the file, runs on a writer thread
+    void OligoCollector::_writer_loop(ReadQueue& queue, fileio::SequenceFileWriter& filewriter) {
+        ReadBatch batch;
+        std::vector<char> complemented;
+        while (queue.pop(batch)) {
+            // keep draining the queue after an error, such that the producer is never blocked
+            if (_writer_failed) {
+                continue;
+            }
+            try {
+                // reads that are reverse strands are only complemented here, as they are written
+                for (size_t i = 0; i < batch.reads.size(); i++) {
+                    unsigned int multiplicity = batch.multiplicities.empty() ? 1 : batch.multiplicities[i];
+                    if (batch.reads.reverse(i)) {
+                        batch.reads.get(i, complemented);
+                        filewriter.write_sequence(complemented.data(), complemented.size(), multiplicity);
+                    } else {
+                        filewriter.write_sequence(batch.reads.data(i), batch.reads.length(i), multiplicity);
+                    }
+                }
+            } catch (...) {
+                std::unique_lock<std::mutex> lock(_writer_mutex);
+                if (!_writer_exception) {
+                    _writer_exception = std::current_exception();
+                }
+                _writer_failed = true;
+            }
+
+            // the written batch is left in the queue for reuse by the producer, but only with buffers of a bounded size
+            batch.reads.release(constants::WRITER_BATCH_KEEP_BASES);
+            batch.multiplicities.clear();
+            if (batch.multiplicities.capacity() > constants::WRITER_BATCH_KEEP_BASES / constants::DEFAULT_SEQUENCE_LENGTH) {
+                std::vector<unsigned int>().swap(batch.multiplicities);
+            }
+        }
+    }
+
+    // rethrow an exception that occurred on a writer thread
+    void OligoCollector::_check_writers() {
+        if (_writer_failed) {
+            std::unique_lock<std::mutex> lock(_writer_mutex);
+            std::rethrow_exception(_writer_exception);
+        }
+    }
+
+    // wait until all reads are written and stop the writer threads
+    void OligoCollector::finish() {
+        if (_finished) {
+            return;
+        }
+        _finished = true;
+
+        // close the queues and wait for the writers to drain them
+        _queue_fw->close();
+        _writer_thread_fw.join();
+        logger.info("Blocked on the writer for {} for {:.2f} s", filewriter_fw->filename, _queue_fw->get_blocked_seconds());
+        if (_create_rv) {
+            _queue_rv->close();
+            _writer_thread_rv.join();
+            logger.info("Blocked on the writer for {} for {:.2f} s", filewriter_rv->filename, _queue_rv->get_blocked_seconds());
+        }
+        _check_writers();
+    }
+
     // set up mutators
     void OligoCollector::set_mutators(std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators) {
         _mutators.reset(&mutators);
+        _mutate_batches = std::none_of(mutators.begin(), mutators.end(), [](std::unique_ptr<mutator::BaseMutator> const &mutator) { return mutator->get_manipulates_count(); });
     }
 
+    // write identical reads of a sequence once with their multiplicity, only without reverse reads
+    void OligoCollector::set_collapse_duplicates(bool collapse_duplicates) {
+        if (collapse_duplicates && _create_rv) {
+            logger.critical("Duplicate reads cannot be collapsed when reverse reads are created");
+            throw std::invalid_argument("Duplicate reads cannot be collapsed when reverse reads are created");
+        }
+        _collapse_duplicates = collapse_duplicates;
+    }
 
-    // collect a sequence vector for writing
-    std::vector<char> OligoCollector::apply_mutators(const std::vector<char>& sequence_vector) {
-        // create vector with the sequence
-        std::vector<std::vector<char>> mutated_sequences;
-        mutated_sequences.push_back(sequence_vector);
+    bool OligoCollector::get_collapse_duplicates() const {
+        return _collapse_duplicates;
+    }
+
+    // replace identical forward reads by a single read with the sum of their multiplicities, keeping the order of their 
+    // first occurrence, reads without a recorded multiplicity occur once
+    void OligoCollector::_collapse(CollectedReads& reads) {
+        // the unique reads are indexed in an open-addressing table holding the index of each unique read plus one,
+        // the table, the unique reads and their counts are kept by the thread, such that their buffers are reused
+        static thread_local std::vector<size_t> unique_index;
+        static thread_local oligobatch::OligoBatch unique_reads;
+        static thread_local std::vector<unsigned int> unique_counts;
+        static thread_local std::vector<char> complemented;
+        bool weighted = reads.multiplicities.size() == reads.fw.size();
+        size_t n_slots = 1;
+        while (n_slots < 2 * reads.fw.size()) {
+            n_slots <<= 1;
+        }
+        unique_index.assign(n_slots, 0);
+        unique_reads.clear();
+        unique_reads.reserve(reads.fw.size(), reads.fw.n_bases());
+        unique_counts.clear();
+
+        std::hash<std::string_view> hash;
+        for (size_t i = 0; i < reads.fw.size(); i++) {
+            // reads that are reverse strands are compared and kept as their reverse complement
+            std::string_view read = reads.fw.view(i);
+            if (reads.fw.reverse(i)) {
+                reads.fw.get(i, complemented);
+                read = std::string_view(complemented.data(), complemented.size());
+            }
+            size_t slot = hash(read) & (n_slots - 1);
+            while (unique_index[slot] != 0 && unique_reads.view(unique_index[slot] - 1) != read) {
+                slot = (slot + 1) & (n_slots - 1);
+            }
+            unsigned int count = weighted ? reads.multiplicities[i] : 1;
+            if (unique_index[slot] == 0) {
+                unique_index[slot] = unique_reads.size() + 1;
+                unique_reads.push_back(read.data(), read.size());
+                unique_counts.push_back(count);
+            } else {
+                unique_counts[unique_index[slot] - 1] += count;
+            }
+        }
+        reads.fw.swap(unique_reads);
+        reads.multiplicities.swap(unique_counts);
+    }
+
+
+    // apply the mutators to a sequence and add the resulting read to the reads
+    void OligoCollector::apply_mutators(const char* sequence, size_t length, oligobatch::OligoBatch& reads) {
+        // copy the sequence to a buffer kept by the thread for reuse
+        static thread_local std::vector<char> oligo;
+        oligo.assign(sequence, sequence + length);
+        _apply_mutators(oligo, reads);
+    }
+
+
+    // apply the mutators to an oligo in place and add the resulting read to the reads
+    void OligoCollector::_apply_mutators(std::vector<char>& oligo, oligobatch::OligoBatch& reads) {
+        // the oligo is only moved to a batch if a mutator changes the number of oligos
+        static thread_local oligobatch::OligoBatch mutated_sequences;
+        bool in_batch = false;
 
         // apply mutators if there are any
         if (_mutators != nullptr) {
             for (std::unique_ptr<mutator::BaseMutator>& mutator : *_mutators) {
-                mutator->process(mutated_sequences);
+                if (!in_batch && !mutator->get_manipulates_count()) {
+                    mutator->process(oligo);
+                    continue;
+                }
+                if (!in_batch) {
+                    mutated_sequences.clear();
+                    mutated_sequences.push_back(oligo);
+                    in_batch = true;
+                }
+                mutator->process_batch(mutated_sequences);
             }
         }
-        return mutated_sequences[0];
+        if (!in_batch) {
+            reads.push_back(oligo);
+        } else if (!mutated_sequences.empty()) {
+            reads.push_back(mutated_sequences.data(0), mutated_sequences.length(0), mutated_sequences.reverse(0));
+        }
+    }
+
+
+    // apply the mutators to all reads of a batch in place, one mutator after another, such that each of them
+    // handles the reads of the whole batch at once
+    void OligoCollector::_apply_mutators(oligobatch::OligoBatch& reads) {
+        if (_mutators == nullptr) {
+            return;
+        }
+        for (std::unique_ptr<mutator::BaseMutator>& mutator : *_mutators) {
+            mutator->process_batch(reads);
+        }
     }
         
 
     // collect a sequence vector for writing
     void OligoCollector::collect_sequence_vector(const std::vector<char>& sequence_vector) {
-        // write the forwards sequence
-        std::vector<char> mutated_sequence_vector = apply_mutators(sequence_vector);
-        filewriter_fw->write_sequence_vector(mutated_sequence_vector);
+        // the scratch memory of the previous sequence is no longer in use
+        arena::resource()->reset();
+        oligobatch::OligoBatch oligos;
+        oligos.push_back(sequence_vector);
+        CollectedReads reads;
+        prepare_reads(oligos, reads);
+        write_reads(reads);
+    }
+
+
+    // apply the mutators to a set of oligos and store the resulting reads, safe to call from worker threads
+    void OligoCollector::prepare_reads(oligobatch::OligoBatch& oligos, CollectedReads& reads) {
+        reads.clear();
+
+        // without mutators and reverse reads, the oligos can be handed over directly
+        if (_mutators == nullptr && !_create_rv) {
+            reads.fw.swap(oligos);
+            if (_collapse_duplicates) {
+                _collapse(reads);
+            }
+            return;
+        }
+
+        // as long as each oligo yields exactly one read, the reads are mutated as whole batches
+        if (_mutate_batches) {
+            reads.fw.append(oligos);
+            _apply_mutators(reads.fw);
+            if (_create_rv) {
+                // the reverse reads are the other strands of the oligos, which are only complemented once a mutator 
+                // copies them or they are written
+                reads.rv.append(oligos);
+                reads.rv.flip();
+                _apply_mutators(reads.rv);
+            }
+            if (_collapse_duplicates) {
+                _collapse(reads);
+            }
+            return;
+        }
+
+        reads.fw.reserve(oligos.size(), oligos.n_bases());
         if (_create_rv) {
-            std::vector<char> rv_sequence_vector = conversion::reverse_complement(sequence_vector);
-            filewriter_rv->write_sequence_vector(apply_mutators(rv_sequence_vector));
+            reads.rv.reserve(oligos.size(), oligos.n_bases());
+        }
+        static thread_local std::vector<char> oligo;
+        static thread_local std::vector<char> reverse_oligo;
+        for (size_t i = 0; i < oligos.size(); i++) {
+            oligos.get(i, oligo);
+            _apply_mutators(oligo, reads.fw);
+            if (_create_rv) {
+                oligos.get(i, reverse_oligo);
+                conversion::reverse_complement_in_place(reverse_oligo.data(), reverse_oligo.size());
+                _apply_mutators(reverse_oligo, reads.rv);
+            }
+        }
+        if (_collapse_duplicates) {
+            _collapse(reads);
+        }
+    }
+
+
+    // merge the reads of consecutive tasks into the reads of the first task, leaves the reads of the other tasks empty
+    void OligoCollector::merge_reads(std::span<CollectedReads> reads) {
+        if (reads.size() < 2) {
+            return;
+        }
+        CollectedReads& merged = reads[0];
+        for (CollectedReads& other : reads.subspan(1)) {
+            merged.append(other);
+            other.clear();
+        }
+        if (_collapse_duplicates) {
+            merged.multiplicities.resize(merged.fw.size(), 1);
+            _collapse(merged);
+        }
+    }
+
+
+    // hand previously prepared reads to the writer threads, leaves the reads empty with the buffers of written reads
+    void OligoCollector::write_reads(CollectedReads& reads) {
+        _check_writers();
+        if (!reads.fw.empty()) {
+            reads.fw.swap(_batch_fw.reads);
+            reads.multiplicities.swap(_batch_fw.multiplicities);
+            _queue_fw->push(_batch_fw);
+            reads.fw.swap(_batch_fw.reads);
+            reads.multiplicities.swap(_batch_fw.multiplicities);
+        }
+        if (_create_rv && !reads.rv.empty()) {
+            reads.rv.swap(_batch_rv.reads);
+            _batch_rv.multiplicities.clear();
+            _queue_rv->push(_batch_rv);
+            reads.rv.swap(_batch_rv.reads);
         }
+        reads.clear();
     }
 
 }
\ No newline at end of file
@@ -2,19 +2,77 @@
 #define OLIGOCOLLECTOR_HPP
 
 #include <vector>
+#include <span>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
 
 #include "fileio.hpp"
 #include "mutator.hpp"
+#include "oligobatch.hpp"
+#include "boundedqueue.hpp"
 
 
 namespace oligocollector {
 
-    // 
+    // reads prepared for a single task of one or more design sequences, waiting to be written
+    struct CollectedReads {
+        oligobatch::OligoBatch fw;
+        oligobatch::OligoBatch rv;
+        std::vector<unsigned int> multiplicities; // multiplicity of each forward read, empty if each read occurs once
+
+        void clear();
+
+        // add the reads of another set at the end, reads without a recorded multiplicity occur once
+        void append(CollectedReads const& other);
+    };
+
+    // reads handed to a writer thread at once
+    struct ReadBatch {
+        oligobatch::OligoBatch reads;
+        std::vector<unsigned int> multiplicities; // empty if each read occurs once
+    };
+
+    // queue of read batches waiting to be written by a writer thread
+    typedef boundedqueue::BoundedQueue<ReadBatch> ReadQueue;
+
+    // applies the sequencing mutators to the oligos and hands the reads to one writer thread per output file
     class OligoCollector {
         private:
             bool _create_rv;
+            bool _collapse_duplicates = false;
+            bool _mutate_batches = true; // whether no mutator changes the number of oligos, such that reads are mutated in batches
+            bool _finished = false;
             std::unique_ptr<std::vector<std::unique_ptr<mutator::BaseMutator>>> _mutators;
+            std::unique_ptr<ReadQueue> _queue_fw;
+            std::unique_ptr<ReadQueue> _queue_rv;
+            ReadBatch _batch_fw; // batches exchanged with the queues, which return the buffers of written batches
+            ReadBatch _batch_rv;
+            std::thread _writer_thread_fw;
+            std::thread _writer_thread_rv;
+            std::mutex _writer_mutex;
+            std::exception_ptr _writer_exception;
+            std::atomic<bool> _writer_failed = false;
+
+            // start the writer threads for all output files
+            void _start_writers();
+
+            // write all read batches from the queue to the file, runs on a writer thread
+            void _writer_loop(ReadQueue& queue, fileio::SequenceFileWriter& filewriter);
+
+            // rethrow an exception that occurred on a writer thread
+            void _check_writers();
+
+            // replace identical forward reads by a single read with the sum of their multiplicities
+            void _collapse(CollectedReads& reads);
+
+            // apply the mutators to an oligo in place and add the resulting read to the reads
+            void _apply_mutators(std::vector<char>& oligo, oligobatch::OligoBatch& reads);
+
+            // apply the mutators to all reads of a batch in place, one mutator after another
+            void _apply_mutators(oligobatch::OligoBatch& reads);
 
         public:
             std::unique_ptr<fileio::SequenceFileWriter> filewriter_fw;
@@ -28,11 +86,28 @@ namespace oligocollector {
             // set up mutators
             void set_mutators(std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators);
 
-            // apply mutators
-            std::vector<char> apply_mutators(const std::vector<char>& sequence_vector);
+            // write identical reads of a sequence once with their multiplicity, only without reverse reads
+            void set_collapse_duplicates(bool collapse_duplicates);
+            bool get_collapse_duplicates() const;
+
+            // apply the mutators to a sequence and add the resulting read to the reads
+            void apply_mutators(const char* sequence, size_t length, oligobatch::OligoBatch& reads);
 
             // collect a sequence vector for writing
             void collect_sequence_vector(const std::vector<char>& sequence_vector);
+
+            // apply the mutators to a set of oligos and store the resulting reads, safe to call from worker threads
+            void prepare_reads(oligobatch::OligoBatch& oligos, CollectedReads& reads);
+
+            // merge the reads of consecutive tasks into the reads of the first task, identical reads are collapsed again,
+            // such that the copies of a sequence spread over multiple tasks are written as a single set of unique reads
+            void merge_reads(std::span<CollectedReads> reads);
+
+            // hand previously prepared reads to the writer threads, leaves the reads empty with the buffers of written reads
+            void write_reads(CollectedReads& reads);
+
+            // wait until all reads are written and stop the writer threads
+            void finish();
     };
     
 }
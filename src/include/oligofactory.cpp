@@ -1,9 +1,16 @@
 #include <vector>
 #include <numeric>
 #include <memory>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <string_view>
 
+#include "oligofactory.hpp"
 #include "constants.hpp"
 #include "mutator.hpp"
+#include "arena.hpp"
+#include "rng.hpp"
 #include "logging.hpp"
 
 static Logger logger("oligofactory", "INFO");
@@ -12,7 +19,7 @@ namespace oligofactory {
 
     // function to generate oligos from a sequence and a set of mutators
     void produce_from_sequence(
-        std::vector<std::vector<char>> &oligo_vectors,
+        oligobatch::OligoBatch &oligo_vectors,
         std::vector<char> const &sequence_vector,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
         ) {
@@ -23,17 +30,178 @@ namespace oligofactory {
 
         // apply each mutator to the oligo vectors
         for (std::unique_ptr<mutator::BaseMutator> &mutator : mutators) {
-            mutator->process(oligo_vectors);
+            mutator->process_batch(oligo_vectors);
         }
     }
 
 
-    // function to generate #n_oligos different oligos from a sequence given a set of mutators
+    // the tables of the design sequence last processed by the calling thread, consecutive tasks of the same
+    // sequence on a thread share them
+    static thread_local SequenceTables _tables;
+
+
+    // function to get the tables of a design sequence, which are only computed again for a different sequence
+    SequenceTables const& get_sequence_tables(
+        std::vector<char> const &sequence_vector,
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        ) {
+
+        // reuse the tables if they were computed for the same sequence and mutators
+        arena::vector<uint64_t> instances(mutators.size(), arena::resource());
+        for (size_t i_mutator = 0; i_mutator < mutators.size(); i_mutator++) {
+            instances[i_mutator] = mutators[i_mutator]->instance;
+        }
+        if (std::equal(_tables.mutators.begin(), _tables.mutators.end(), instances.begin(), instances.end()) && _tables.sequence == sequence_vector) {
+            return _tables;
+        }
+        _tables.sequence = sequence_vector;
+        _tables.mutators.assign(instances.begin(), instances.end());
+        _tables.cumulative_hazard.resize(mutators.size());
+        _tables.first_slot.clear();
+        _tables.p_event_before.clear();
+
+        // get the cumulative hazard of each mutator over its event slots in the sequence, -log(1-p) summed up to each slot,
+        // slots with certain events have no finite hazard, these mutators use no table
+        arena::vector<double> p_event(arena::resource());
+        bool all_tables = true;
+        for (size_t i_mutator = 0; i_mutator < mutators.size(); i_mutator++) {
+            std::vector<double> &hazard = _tables.cumulative_hazard[i_mutator];
+            hazard.clear();
+            if (!mutators[i_mutator]->get_event_probabilities(sequence_vector, p_event) || std::any_of(p_event.begin(), p_event.end(), [](double p) { return p >= 1.0; })) {
+                all_tables = false;
+                continue;
+            }
+            hazard.resize(p_event.size() + 1, 0.0);
+            for (size_t i = 0; i < p_event.size(); i++) {
+                hazard[i + 1] = hazard[i] - std::log1p(-p_event[i]);
+            }
+        }
+
+        // get the probability that at least one event occurs before each event slot, when the mutators are applied to
+        // the unmodified sequence one after another, with the slots ordered by mutator and then slot of the mutator
+        if (all_tables) {
+            _tables.first_slot.assign(mutators.size() + 1, 0);
+            for (size_t i_mutator = 0; i_mutator < mutators.size(); i_mutator++) {
+                _tables.first_slot[i_mutator + 1] = _tables.first_slot[i_mutator] + _tables.cumulative_hazard[i_mutator].size() - 1;
+            }
+            _tables.p_event_before.assign(_tables.first_slot.back() + 1, 0.0);
+            double hazard_before = 0.0;
+            for (size_t i_mutator = 0; i_mutator < mutators.size(); i_mutator++) {
+                const std::vector<double> &hazard = _tables.cumulative_hazard[i_mutator];
+                const size_t first_slot = _tables.first_slot[i_mutator];
+                for (size_t i = 0; i + 1 < hazard.size(); i++) {
+                    _tables.p_event_before[first_slot + i + 1] = -std::expm1(-(hazard_before + hazard[i + 1]));
+                }
+                hazard_before += hazard.back();
+            }
+        }
+        return _tables;
+    }
+
+
+    // function to generate the oligos from a single copy of the sequence and add them to the generated oligos,
+    // mutators draw their events from the tables of the sequence as long as the copy is unmodified
+    void produce_from_tables(
+        oligobatch::OligoBatch &generated_oligos,
+        SequenceTables const &tables,
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        ) {
+
+        // the copy is edited in place in a buffer kept by the thread, until a mutator changes the number of oligos
+        static thread_local std::vector<char> oligo;
+        static thread_local oligobatch::OligoBatch oligo_vectors;
+        const std::string_view sequence(tables.sequence.data(), tables.sequence.size());
+        oligo = tables.sequence;
+        bool unmodified = true;
+        bool in_batch = false;
+        for (size_t i_mutator = 0; i_mutator < mutators.size(); i_mutator++) {
+            mutator::BaseMutator &mutator = *mutators[i_mutator];
+
+            // the tables are only valid as long as no mutator has edited the copy
+            if (unmodified && !tables.cumulative_hazard[i_mutator].empty()) {
+                // the buffer still holds the unmodified sequence, even if the oligos have moved to the batch
+                if (mutator.process_single_with_hazard(oligo, tables.cumulative_hazard[i_mutator]) && oligo != tables.sequence) {
+                    unmodified = false;
+                    if (in_batch) {
+                        oligo_vectors.clear();
+                        oligo_vectors.push_back(oligo);
+                    }
+                }
+            } else if (!in_batch && !mutator.get_manipulates_count()) {
+                mutator.process(oligo);
+                unmodified = unmodified && oligo == tables.sequence;
+            } else {
+                if (!in_batch) {
+                    oligo_vectors.clear();
+                    oligo_vectors.push_back(oligo);
+                    in_batch = true;
+                }
+                mutator.process_batch(oligo_vectors);
+                unmodified = unmodified && oligo_vectors.size() == 1 && !oligo_vectors.reverse(0) && oligo_vectors.view(0) == sequence;
+            }
+        }
+
+        if (in_batch) {
+            generated_oligos.append(oligo_vectors);
+        } else {
+            generated_oligos.push_back(oligo);
+        }
+    }
+
+
+    // function to generate #n_oligos oligos from a sequence, by drawing the number of copies without any event at 
+    // once and generating only the other copies, conditioned on the slot of their first event
+    void generate_oligos_by_first_event(
+        oligobatch::OligoBatch &generated_oligos,
+        SequenceTables const &tables,
+        unsigned int n_oligos,
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        unsigned int first_copy
+        ) {
+
+        // draw the number of copies without any event, on a substream separate from those of the copies
+        const std::vector<double> &p_event_before = tables.p_event_before;
+        const double p_touched = p_event_before.back();
+        const double p_untouched = 1.0 - p_touched;
+        unsigned int n_untouched = n_oligos;
+        if (p_untouched < 1.0) {
+            rng::set_copy(constants::RNG_COPY_AGGREGATE | first_copy);
+            std::binomial_distribution<unsigned int> binomial(n_oligos, p_untouched);
+            n_untouched = binomial(rng::rng);
+        }
+        generated_oligos.push_back(tables.sequence, n_untouched);
+
+        // generate each of the other copies from the first event onwards
+        static thread_local std::vector<char> oligo;
+        for (unsigned int i_oligo = 0; i_oligo < n_oligos - n_untouched; i_oligo++) {
+            rng::set_copy(first_copy + i_oligo + 1);
+
+            // draw the slot of the first event from the cumulative probability of an event up to each slot
+            double u = rng::random_double() * p_touched;
+            auto first_event = std::upper_bound(p_event_before.begin() + 1, p_event_before.end(), u);
+            size_t slot = std::min((size_t)(first_event - p_event_before.begin() - 1), p_event_before.size() - 2);
+            size_t i_first_mutator = std::upper_bound(tables.first_slot.begin(), tables.first_slot.end(), slot) - tables.first_slot.begin() - 1;
+
+            // the mutators before the first event leave the sequence unmodified, all after it are applied as usual,
+            // in place as none of them changes the number of oligos
+            oligo = tables.sequence;
+            mutators[i_first_mutator]->process_single_with_hazard(oligo, tables.cumulative_hazard[i_first_mutator], slot - tables.first_slot[i_first_mutator]);
+            for (size_t i_mutator = i_first_mutator + 1; i_mutator < mutators.size(); i_mutator++) {
+                mutators[i_mutator]->process(oligo);
+            }
+            generated_oligos.push_back(oligo);
+        }
+    }
+
+
+    // function to generate #n_oligos different oligos from a sequence given a set of mutators,
+    // starting with copy #first_copy of the sequence
     void generate_oligos(
-        std::vector<std::vector<char>> &generated_oligos,
+        oligobatch::OligoBatch &generated_oligos,
         std::vector<char> const &sequence_vector, 
         unsigned int n_oligos,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        unsigned int first_copy
         ) {
         
         // short-circuit if there are no reads to generate
@@ -42,29 +210,29 @@ namespace oligofactory {
         }
         // short-circuit if there are no mutators
         if (mutators.size() == 0) {
-            for (int i = 0; i < n_oligos; i++) {
-                generated_oligos.push_back(sequence_vector);
-            }
+            generated_oligos.push_back(sequence_vector, n_oligos);
             return;
         }
 
-        // this will hold all of the oligos while they move through the error pipeline
-        std::vector<std::vector<char>> oligo_vectors;
+        // if all events are independent per position, only the copies with events need to be generated
+        SequenceTables const &tables = get_sequence_tables(sequence_vector, mutators);
+        if (!tables.p_event_before.empty()) {
+            generate_oligos_by_first_event(generated_oligos, tables, n_oligos, mutators, first_copy);
+            return;
+        }
 
         // loop through each oligo to be generated from this sequence
         for (int i_oligo = 0; i_oligo < n_oligos; i_oligo++) {
 
+            // each copy draws from its own substream
+            rng::set_copy(first_copy + i_oligo + 1);
+
             // generate the oligos derived from the current sequence
-            produce_from_sequence(
-                oligo_vectors,
-                sequence_vector,
+            produce_from_tables(
+                generated_oligos,
+                tables,
                 mutators
             );
-
-            // copy the oligos to the generated oligos vector
-            for (std::vector<char> &oligo_vector : oligo_vectors) {
-                generated_oligos.push_back(oligo_vector);
-            }
         }
     }
 
@@ -3,23 +3,54 @@
 
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 #include "mutator.hpp"
+#include "oligobatch.hpp"
 
 
 namespace oligofactory {
 
+    // tables of a design sequence that are shared by all of its copies, valid as long as a copy is unmodified
+    struct SequenceTables {
+        std::vector<char> sequence;
+        std::vector<uint64_t> mutators; // instances of the mutators the tables were computed for
+        std::vector<std::vector<double>> cumulative_hazard; // for each mutator, empty if it does not provide event probabilities
+        std::vector<size_t> first_slot; // for each mutator, its first slot among the event slots of all mutators
+        std::vector<double> p_event_before; // over the event slots of all mutators, empty unless all mutators have a hazard
+    };
+
     void produce_from_sequence(
-        std::vector<std::vector<char>> &generated_oligos,
+        oligobatch::OligoBatch &generated_oligos,
+        std::vector<char> const &sequence_vector,
+        std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators
+    );
+
+    SequenceTables const& get_sequence_tables(
         std::vector<char> const &sequence_vector,
         std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators
     );
 
+    void produce_from_tables(
+        oligobatch::OligoBatch &generated_oligos,
+        SequenceTables const &tables,
+        std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators
+    );
+
+    void generate_oligos_by_first_event(
+        oligobatch::OligoBatch &generated_oligos,
+        SequenceTables const &tables,
+        unsigned int n_oligos,
+        std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators,
+        unsigned int first_copy = 0
+    );
+
     void generate_oligos(
-        std::vector<std::vector<char>> &generated_oligos,
+        oligobatch::OligoBatch &generated_oligos,
         std::vector<char> const &sequence_vector, 
         unsigned int n_oligos,
-        std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>> &mutators,
+        unsigned int first_copy = 0
     );
 
 } // namespace oligofactory
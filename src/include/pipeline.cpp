@@ -1,4 +1,5 @@
 #include <vector>
+#include <span>
 #include <numeric>
 #include <memory>
 #include <time.h>
@@ -9,9 +10,13 @@
 #include "coverage.hpp"
 #include "helpers.hpp"
 #include "oligofactory.hpp"
+#include "oligobatch.hpp"
 #include "oligocollector.hpp"
 #include "mutator.hpp"
 #include "progressbar.hpp"
+#include "threadpool.hpp"
+#include "arena.hpp"
+#include "rng.hpp"
 #include "logging.hpp"
 
 static Logger logger("pipeline", "INFO");
@@ -19,52 +24,189 @@ static Logger logger("pipeline", "INFO");
 
 namespace pipeline {
 
+    // read up to max_sequences design sequences into the chunk
+    void read_chunk(
+        fileio::SequenceFileReader& reader, 
+        SequenceChunk& chunk,
+        size_t first_index,
+        size_t max_sequences
+        ) {
+
+        // ensure there is space for all sequences
+        if (chunk.sequences.size() < max_sequences) {
+            chunk.sequences.resize(max_sequences);
+        }
+
+        // fill the chunk until it is full or the file is exhausted
+        chunk.first_index = first_index;
+        chunk.n_sequences = 0;
+        while (chunk.n_sequences < max_sequences && reader.get_sequence(chunk.sequences[chunk.n_sequences])) {
+            chunk.n_sequences++;
+        }
+    }
+
+
+    // split the sequences of a chunk into tasks of at most COPIES_PER_TASK copies, such that sequences with a high 
+    // coverage are spread over multiple workers, while consecutive sequences with a low coverage are packed into tasks 
+    // of up to OLIGOS_PER_TASK copies, such that they are processed as a single batch
+    // the packing restarts every SEQUENCES_PER_THREAD_CHUNK sequences, the size of a chunk for a single thread, such 
+    // that it does not depend on the number of threads
+    void split_chunk(
+        SequenceChunk& chunk,
+        std::vector<unsigned int> const& oligo_counts
+        ) {
+        chunk.tasks.clear();
+        bool packing = false;
+        for (size_t i = 0; i < chunk.n_sequences; i++) {
+            unsigned int n_oligos = oligo_counts[chunk.first_index + i];
+            if ((chunk.first_index + i) % constants::SEQUENCES_PER_THREAD_CHUNK == 0) {
+                packing = false;
+            }
+
+            // add the sequence to the open task if it still fits
+            if (n_oligos <= constants::COPIES_PER_TASK) {
+                if (packing && chunk.tasks.back().n_copies + n_oligos <= constants::OLIGOS_PER_TASK) {
+                    chunk.tasks.back().n_sequences++;
+                    chunk.tasks.back().n_copies += n_oligos;
+                } else if (n_oligos > 0) {
+                    chunk.tasks.push_back({i, 1, 0, n_oligos});
+                    packing = true;
+                }
+                continue;
+            }
+
+            packing = false;
+            for (unsigned int first_copy = 0; first_copy < n_oligos; first_copy += constants::COPIES_PER_TASK) {
+                chunk.tasks.push_back({i, 1, first_copy, std::min(n_oligos - first_copy, constants::COPIES_PER_TASK)});
+            }
+        }
+
+        // ensure there is space for the reads of all tasks
+        if (chunk.reads.size() < chunk.tasks.size()) {
+            chunk.reads.resize(chunk.tasks.size());
+        }
+    }
+
+
+    // write the reads of a processed chunk in the order of the design sequences and copies
+    void write_chunk(
+        oligocollector::OligoCollector& collector,
+        SequenceChunk& chunk
+        ) {
+        for (size_t i = 0; i < chunk.tasks.size(); i++) {
+            // the copies of a sequence spread over multiple tasks are collapsed together, such that each unique read of 
+            // a sequence is written once
+            size_t n_tasks = 1;
+            if (collector.get_collapse_duplicates()) {
+                while (i + n_tasks < chunk.tasks.size() && chunk.tasks[i + n_tasks].first_copy > 0) {
+                    n_tasks++;
+                }
+                collector.merge_reads(std::span(chunk.reads).subspan(i, n_tasks));
+            }
+            collector.write_reads(chunk.reads[i]);
+            i += n_tasks - 1;
+        }
+    }
+
+
     void process(
         fileio::SequenceFileReader& reader, 
         oligocollector::OligoCollector& collector,
         std::vector<unsigned int> const& oligo_counts,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        int n_threads,
+        unsigned int rng_stream
         ) {
 
-        // these vectors will hold the sequence and the oligos generated for it
-        std::vector<char> sequence_vector;
-        sequence_vector.reserve(constants::DEFAULT_SEQUENCE_LENGTH);
-        std::vector<std::vector<char>> oligos = std::vector<std::vector<char>>();
-
         // create a progress bar and log the start of the process
-        logger.info("Generating {} oligos from {} sequences", std::accumulate(oligo_counts.begin(), oligo_counts.end(), 0), oligo_counts.size());
+        logger.info("Generating {} oligos from {} sequences", std::accumulate(oligo_counts.begin(), oligo_counts.end(), (uint64_t)0), oligo_counts.size());
         progressbar::ProgressBar progress_bar(oligo_counts.size(), "Generating oligos");
         time_t start,end;
         time(&start);
-
-        // iterate over the sequences in the input file
-        int i_seq = 0;
-        while (reader.get_sequence(sequence_vector)) {
-
-            // short-circuit if there are no oligos to generate for this sequence
-            if (oligo_counts[i_seq] == 0) {
-                i_seq++;
-                progress_bar.update(i_seq);
-                continue;
+        uint64_t heap_allocations = arena::count_heap_allocations();
+        uint64_t batch_allocations = oligobatch::count_allocations();
+
+        // the workers generate the reads of one chunk while the previous chunk is written
+        threadpool::ThreadPool pool(n_threads);
+        const size_t chunk_size = constants::SEQUENCES_PER_THREAD_CHUNK * n_threads;
+        SequenceChunk chunks[2];
+        SequenceChunk* current = &chunks[0];
+        SequenceChunk* pending = &chunks[1];
+
+        // generates the reads for a single task of a chunk, called from the workers
+        auto process_task = [&](SequenceChunk& chunk, size_t i_task) {
+            const SequenceTask& task = chunk.tasks[i_task];
+            oligocollector::CollectedReads& reads = chunk.reads[i_task];
+
+            // generate the oligos and reads of the sequences of the current task one sequence after another, the batch and 
+            // the reads of a single sequence are kept by the thread, and exchange their buffers with those of written reads
+            static thread_local oligobatch::OligoBatch oligos;
+            static thread_local oligocollector::CollectedReads sequence_reads;
+            for (size_t j = 0; j < task.n_sequences; j++) {
+                size_t i_seq = chunk.first_index + task.i_sequence + j;
+                const std::vector<char>& sequence = chunk.sequences[task.i_sequence + j];
+                unsigned int n_copies = task.n_sequences == 1 ? task.n_copies : oligo_counts[i_seq];
+                oligos.clear();
+                oligos.reserve(n_copies, n_copies * sequence.size());
+
+                // each sequence draws from its own substream, independent of the thread processing it
+                rng::set_substream(rng_stream, i_seq);
+
+                // the scratch memory of the previous sequence is no longer in use
+                arena::resource()->reset();
+                oligofactory::generate_oligos(oligos, sequence, n_copies, mutators, task.first_copy);
+
+                // its reads draw from a separate substream of the sequence, such that they do not depend on the other 
+                // sequences packed into the same task, and are added to the reads of the task
+                arena::resource()->reset();
+                rng::set_substream(constants::RNG_STREAM_READS, i_seq, task.first_copy + 1);
+                if (j == 0) {
+                    collector.prepare_reads(oligos, reads);
+                } else {
+                    collector.prepare_reads(oligos, sequence_reads);
+                    reads.append(sequence_reads);
+                }
+            }
+        };
+
+        // iterate over the sequences in the input file, chunk by chunk
+        size_t i_seq = 0;
+        read_chunk(reader, *current, 0, chunk_size);
+        while (current->n_sequences > 0) {
+
+            // check that we do not process more sequences than expected
+            i_seq = current->first_index + current->n_sequences;
+            if (i_seq > oligo_counts.size()) {
+                logger.critical("Processed {} sequences, but expected {}", i_seq, oligo_counts.size());
+                throw std::runtime_error("Processed " + std::to_string(i_seq) + " sequences, but expected " + std::to_string(oligo_counts.size()));
             }
 
-            // clear the oligos vector and ensure sufficient space in it
-            oligos.clear();
-            oligos.reserve(oligo_counts[i_seq]);
-
-            // generate the oligos for the current sequence
-            oligofactory::generate_oligos(oligos, sequence_vector, oligo_counts[i_seq], mutators);
+            // generate the oligos for the current chunk in the background
+            SequenceChunk* chunk = current;
+            split_chunk(*chunk, oligo_counts);
+            pool.start(chunk->tasks.size(), [&process_task, chunk](size_t i_task) { process_task(*chunk, i_task); });
 
-            // write the oligos to the output file
-            for (std::vector<char>& oligo : oligos) {
-                collector.collect_sequence_vector(oligo);
+            // meanwhile, write the previous chunk and read the next one
+            if (pending->n_sequences > 0) {
+                write_chunk(collector, *pending);
+                progress_bar.update(pending->first_index + pending->n_sequences);
             }
+            read_chunk(reader, *pending, i_seq, chunk_size);
+
+            // we are done with the current chunk
+            pool.wait();
+            std::swap(current, pending);
+        }
 
-            // we are done with the current sequence
-            i_seq++;
-            progress_bar.update(i_seq);
+        // write the last chunk and wait for the writers to finish
+        if (pending->n_sequences > 0) {
+            write_chunk(collector, *pending);
+            progress_bar.update(pending->first_index + pending->n_sequences);
         }
         progress_bar.close();
+        collector.finish();
+        pool.log_stats();
+        logger.info("Allocated {} blocks of scratch memory and {} oligo buffers", arena::count_heap_allocations() - heap_allocations, oligobatch::count_allocations() - batch_allocations);
 
         // check that we have processed all sequences
         if (i_seq != oligo_counts.size()) {
@@ -74,7 +216,7 @@ namespace pipeline {
 
         // log the end of the process and the duration it took
         time(&end);
-        logger.info("Finished generating {} oligos from {} sequences in {} seconds", std::accumulate(oligo_counts.begin(), oligo_counts.end(), 0), i_seq, difftime(end, start));
+        logger.info("Finished generating {} oligos from {} sequences in {} seconds", std::accumulate(oligo_counts.begin(), oligo_counts.end(), (uint64_t)0), i_seq, difftime(end, start));
     }
 
 
@@ -83,25 +225,30 @@ namespace pipeline {
         fileio::SequenceFileWriter& writer,
         float initial_coverage_bias,
         float mean_physical_coverage,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        int n_threads
         ) {
 
         // get the number of design sequences in the input file
-        int n_seqs = reader.count_sequences();
+        uint64_t n_seqs = reader.count_sequences();
 
         // get the initial coverage for the sequences based on the coverage bias
+        rng::set_substream(constants::RNG_STREAM_COVERAGE, 0);
         logger.info("Generating synthesis coverage with bias {}", initial_coverage_bias);
-        std::vector<unsigned int> initial_sequence_coverage = coverage::get_initial_coverage(n_seqs, initial_coverage_bias);
+        std::vector<unsigned int> initial_sequence_coverage = coverage::get_initial_coverage(n_seqs, initial_coverage_bias, 100, n_threads);
 
         // sample the initial coverage to get the actual physical oligo coverage
-        int n_sampled_oligos = (int) n_seqs * mean_physical_coverage;
+        uint64_t n_sampled_oligos = (uint64_t) ((double) n_seqs * mean_physical_coverage);
         logger.info("Sampling for a mean physical coverage of {}", mean_physical_coverage);
-        std::vector<unsigned int> physical_coverage = coverage::sample_by_count(initial_sequence_coverage, n_sampled_oligos);
+        rng::set_substream(constants::RNG_STREAM_COVERAGE, 1);
+        std::vector<unsigned int> physical_coverage = coverage::sample_by_count(initial_sequence_coverage, n_sampled_oligos, n_threads);
 
         // process the sequences and write them to the output file
         logger.info("Processing errors for synthesis and sampling");
+        // identical copies of a design sequence are written once with their multiplicity
         oligocollector::OligoCollector collector(writer);
-        process(reader, collector, physical_coverage, mutators);
+        collector.set_collapse_duplicates(true);
+        process(reader, collector, physical_coverage, mutators, n_threads, constants::RNG_STREAM_SYNTHESIS);
         logger.info("Finished synthesis and sampling");
     }
 
@@ -110,20 +257,23 @@ namespace pipeline {
         fileio::SequenceFileReader& reader, 
         fileio::SequenceFileWriter& writer_fw,
         fileio::SequenceFileWriter& writer_rv,
-        int n_sequences,
+        uint64_t n_sequences,
         float mean_sequencing_coverage,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& sequencing_mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& sequencing_mutators,
+        int n_threads
         ) {
 
-        // get the number of oligo sequences in the input file
-        int n_seqs = reader.count_sequences();
+        // get the unique oligo sequences in the input file and how often each occurs, recorded in the file
+        uint64_t n_seqs = reader.count_sequences();
+        std::vector<unsigned int> multiplicities = reader.get_multiplicities();
+        logger.info("Read {} oligos stored as {} unique sequences", std::accumulate(multiplicities.begin(), multiplicities.end(), (uint64_t)0), n_seqs);
 
-        // sample the oligos uniformly to get the actual sequencing reads
-        int n_reads = (int) mean_sequencing_coverage * n_sequences;
+        // sample the oligos uniformly to get the actual sequencing reads, each unique sequence weighted by its multiplicity
+        rng::set_substream(constants::RNG_STREAM_COVERAGE, 2);
+        uint64_t n_reads = (uint64_t) ((double) mean_sequencing_coverage * n_sequences);
         logger.info("Sampling for a mean sequencing coverage of {}", mean_sequencing_coverage);
-        std::vector<unsigned int> sequence_coverages(n_seqs, 1); // all oligos appear once
-        std::vector<unsigned int> sequencing_coverage = coverage::sample_by_count(sequence_coverages, n_reads);
+        std::vector<unsigned int> sequencing_coverage = coverage::sample_by_count(multiplicities, n_reads, n_threads);
 
         // generate a sequencing file handler to take care of the paired-end reads
         oligocollector::OligoCollector collector(writer_fw, writer_rv);
@@ -131,7 +281,7 @@ namespace pipeline {
 
         // process the oligos and write them to the output file
         logger.info("Processing errors for recovery and sequencing");
-        process(reader, collector, sequencing_coverage, mutators);
+        process(reader, collector, sequencing_coverage, mutators, n_threads, constants::RNG_STREAM_SEQUENCING);
         logger.info("Finished recovery and sequencing");
     }
 
@@ -148,19 +298,21 @@ namespace pipeline {
         std::vector<std::unique_ptr<mutator::BaseMutator>>& initial_mutators,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& recovery_mutators,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& sequencing_mutators,
-        fileio::WriteFileType write_file_type
+        fileio::WriteFileType write_file_type,
+        int n_threads
     ) {
 
         // open the input and output files
         fileio::SequenceFileReader input_reader(input_filename);
         fileio::SequenceFileWriter intermediate_writer(intermediate_filename, fileio::WriteFileType::BINARY);
 
-        // get the number of design sequences
-        int n_sequences = input_reader.count_sequences();
+        // read the design sequences into memory once, they are counted and processed from there
+        input_reader.load();
+        uint64_t n_sequences = input_reader.count_sequences();
 
         // run the synthesis and sampling process
         try {
-            pipeline::synthesis_and_sampling(input_reader, intermediate_writer, initial_coverage_bias, mean_physical_coverage, initial_mutators);
+            pipeline::synthesis_and_sampling(input_reader, intermediate_writer, initial_coverage_bias, mean_physical_coverage, initial_mutators, n_threads);
         } catch (std::exception& e) {
             logger.critical("An error occurred during synthesis and sampling: {}", e.what());
             intermediate_writer.remove();
@@ -178,7 +330,7 @@ namespace pipeline {
 
         // run the recovery and sequencing process
         try {
-            pipeline::recovery_and_sequencing(intermediate_reader, writer_fw, writer_rv, n_sequences, mean_sequencing_coverage, recovery_mutators, sequencing_mutators);
+            pipeline::recovery_and_sequencing(intermediate_reader, writer_fw, writer_rv, n_sequences, mean_sequencing_coverage, recovery_mutators, sequencing_mutators, n_threads);
         } catch (std::exception& e) {
             logger.critical("An error occurred during recovery and sequencing: {}", e.what());
             intermediate_reader.remove();
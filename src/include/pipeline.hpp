@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <memory>
+#include <cstdint>
 
 #include "fileio.hpp"
 #include "oligocollector.hpp"
@@ -11,11 +12,49 @@
 
 namespace pipeline {
 
+    // a range of copies of a single design sequence, or all copies of several consecutive design sequences with few copies,
+    // processed by one worker as a single batch
+    // the split into tasks only depends on the oligo counts, not on the number of threads
+    struct SequenceTask {
+        size_t i_sequence; // index of the first sequence within the chunk
+        size_t n_sequences;
+        unsigned int first_copy;
+        unsigned int n_copies; // number of copies of all sequences
+    };
+
+    // a block of consecutive design sequences and the reads generated from them, for each task
+    struct SequenceChunk {
+        size_t first_index = 0;
+        size_t n_sequences = 0;
+        std::vector<std::vector<char>> sequences;
+        std::vector<SequenceTask> tasks;
+        std::vector<oligocollector::CollectedReads> reads;
+    };
+
+    void read_chunk(
+        fileio::SequenceFileReader& reader, 
+        SequenceChunk& chunk,
+        size_t first_index,
+        size_t max_sequences
+    );
+
+    void split_chunk(
+        SequenceChunk& chunk,
+        std::vector<unsigned int> const& oligo_counts
+    );
+
+    void write_chunk(
+        oligocollector::OligoCollector& collector,
+        SequenceChunk& chunk
+    );
+
     void process(
         fileio::SequenceFileReader& reader, 
         oligocollector::OligoCollector& collector,
         std::vector<unsigned int> const& oligo_counts,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        int n_threads,
+        unsigned int rng_stream
     );
 
     void synthesis_and_sampling(
@@ -23,16 +62,19 @@ namespace pipeline {
         fileio::SequenceFileWriter& writer,
         float initial_coverage_bias,
         float mean_physical_coverage,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        int n_threads
     );
 
     void recovery_and_sequencing(
         fileio::SequenceFileReader& reader, 
         fileio::SequenceFileWriter& writer_fw,
         fileio::SequenceFileWriter& writer_rv,
-        int n_sequences,
+        uint64_t n_sequences,
         float mean_sequencing_coverage,
-        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators,
+        std::vector<std::unique_ptr<mutator::BaseMutator>>& sequencing_mutators,
+        int n_threads
     );
 
     void run(
@@ -46,7 +88,8 @@ namespace pipeline {
         std::vector<std::unique_ptr<mutator::BaseMutator>>& initial_mutators,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& recovery_mutators,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& sequencing_mutators,
-        fileio::WriteFileType write_file_type
+        fileio::WriteFileType write_file_type,
+        int n_threads = 1
     );
 
 } // namespace pipeline
@@ -3,13 +3,14 @@
 
 #include <iostream>
 #include <time.h>
+#include <cstdint>
 
 namespace progressbar {
 
     class ProgressBar {
         private:
-            int _total;
-            int _current;
+            uint64_t _total;
+            uint64_t _current;
             int _width;
             bool _finished = false;
             time_t _lastupdate;
@@ -17,7 +18,7 @@ namespace progressbar {
             std::string _label;
 
         public:
-            ProgressBar(int total, std::string label = "", int width = 50) : _total(total), _current(0), _width(width), _label(label) {
+            ProgressBar(uint64_t total, std::string label = "", int width = 50) : _total(total), _current(0), _width(width), _label(label) {
                 std::cout << _label << ": [" << std::string(_width, ' ') << "] 0% 0/" << _total << std::flush;
                 time(&_lastupdate);
             }
@@ -28,7 +29,7 @@ namespace progressbar {
                 }
             }
 
-            void update(int current) {
+            void update(uint64_t current) {
                 time(&_now);
                 if (current == _total || difftime(_now, _lastupdate) > 0.0) { // update every second
                     _lastupdate = _now;
@@ -36,8 +37,8 @@ namespace progressbar {
                     return;
                 }
                 _current = current;
-                int progress = (int)((float)_current / _total * _width);
-                std::cout << "\r" << _label << ": [" << std::string(progress, '=') << std::string(_width - progress, ' ') << "] " << (int)((float)_current / _total * 100) << "% " << _current << "/" << _total << std::flush;
+                int progress = (int)((double)_current / _total * _width);
+                std::cout << "\r" << _label << ": [" << std::string(progress, '=') << std::string(_width - progress, ' ') << "] " << (int)((double)_current / _total * 100) << "% " << _current << "/" << _total << std::flush;
             }
 
             void close() {
@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <random>
 
 #include "rng.hpp"
@@ -5,17 +6,114 @@
 
 namespace rng {
 
-    std::mt19937 rng;
+    // constants of the Philox4x32 round function and key schedule
+    inline constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+    inline constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+    inline constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+    inline constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+    inline constexpr int PHILOX_ROUNDS = 10;
 
-    void seed_rng(unsigned int seed) {
+    Philox::Philox(uint64_t seed) {
+        this->seed(seed);
+    }
+
+    void Philox::seed(uint64_t seed) {
+        _key[0] = (uint32_t)seed;
+        _key[1] = (uint32_t)(seed >> 32);
+        _counter[0] = 0;
+        _index = 4;
+    }
+
+    // the counter holds the block counter, the copy, and the sequence with the stream in its top byte
+    void Philox::set_substream(uint32_t stream, uint64_t sequence, uint32_t copy) {
+        _counter[0] = 0;
+        _counter[1] = copy;
+        _counter[2] = (uint32_t)sequence;
+        _counter[3] = ((uint32_t)(sequence >> 32) & 0x00FFFFFF) | (stream << 24);
+        _index = 4;
+    }
+
+    void Philox::_generate_block() {
+        std::array<uint32_t, 4> ctr = _counter;
+        std::array<uint32_t, 2> key = _key;
+        for (int i = 0; i < PHILOX_ROUNDS; i++) {
+            uint64_t product0 = (uint64_t)PHILOX_M0 * ctr[0];
+            uint64_t product1 = (uint64_t)PHILOX_M1 * ctr[2];
+            ctr = {
+                (uint32_t)(product1 >> 32) ^ ctr[1] ^ key[0],
+                (uint32_t)product1,
+                (uint32_t)(product0 >> 32) ^ ctr[3] ^ key[1],
+                (uint32_t)product0
+            };
+            key[0] += PHILOX_W0;
+            key[1] += PHILOX_W1;
+        }
+        _output = ctr;
+        _counter[0]++;
+        _index = 0;
+    }
+
+    void Philox::discard(unsigned long long n) {
+        // use the remaining numbers of the current block first
+        while (n > 0 && _index < 4) {
+            _index++;
+            n--;
+        }
+        // then skip whole blocks by advancing the counter
+        _counter[0] += (uint32_t)(n / 4);
+        if (n % 4 > 0) {
+            _generate_block();
+            _index = n % 4;
+        }
+    }
+
+    Philox::result_type Philox::operator()() {
+        if (_index == 4) {
+            _generate_block();
+        }
+        return _output[_index++];
+    }
+
+
+    thread_local Philox rng;
+    uint64_t _seed = 0;
+    thread_local uint32_t _stream = 0;
+    thread_local uint64_t _sequence = 0;
+
+    void seed_rng(uint64_t seed) {
+        _seed = seed;
         rng.seed(seed);
     }
 
+    void set_substream(uint32_t stream, uint64_t sequence, uint32_t copy) {
+        _stream = stream;
+        _sequence = sequence;
+        rng.seed(_seed);
+        rng.set_substream(stream, sequence, copy);
+    }
+
+    void set_copy(uint32_t copy) {
+        rng.set_substream(_stream, _sequence, copy);
+    }
+
+    uint32_t current_stream() {
+        return _stream;
+    }
+
+    uint64_t current_sequence() {
+        return _sequence;
+    }
+
     float random_float() {
         std::uniform_real_distribution<float> dist(0.0, 1.0);
         return dist(rng);
     }
 
+    double random_double() {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        return dist(rng);
+    }
+
     int random_int(int min, int max) {
         std::uniform_int_distribution<int> dist(min, max);
         return dist(rng);
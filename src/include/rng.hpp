@@ -1,15 +1,65 @@
 #ifndef RNG_HPP
 #define RNG_HPP
 
+#include <cstdint>
+#include <array>
 #include <random>
 
 namespace rng {
-    extern std::mt19937 rng;
 
-    void seed_rng(unsigned int seed);
+    // counter-based Philox4x32-10 generator (Salmon et al., SC'11)
+    // the 64-bit seed is used as key, and the counter is split into a substream 
+    // (stream, sequence, copy) and a block counter, such that each substream can be 
+    // jumped to directly without generating any of the preceding numbers
+    class Philox {
+        private:
+            std::array<uint32_t, 2> _key = {0, 0};
+            std::array<uint32_t, 4> _counter = {0, 0, 0, 0};
+            std::array<uint32_t, 4> _output = {0, 0, 0, 0};
+            int _index = 4;
+
+            // generate the next block of four numbers and advance the block counter
+            void _generate_block();
+
+        public:
+            using result_type = uint32_t;
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return UINT32_MAX; }
+
+            Philox(uint64_t seed = 0);
+
+            // set the key and restart the current substream
+            void seed(uint64_t seed);
+
+            // jump to the start of a substream
+            void set_substream(uint32_t stream, uint64_t sequence, uint32_t copy);
+
+            // skip the next n numbers
+            void discard(unsigned long long n);
+
+            result_type operator()();
+    };
+
+    // each thread draws from its own generator
+    extern thread_local Philox rng;
+
+    void seed_rng(uint64_t seed);
+
+    // jump the calling thread's generator to the substream of a sequence, copy index 0 is 
+    // used for draws concerning the whole sequence
+    void set_substream(uint32_t stream, uint64_t sequence, uint32_t copy = 0);
+
+    // jump the calling thread's generator to the substream of another copy of the current sequence
+    void set_copy(uint32_t copy);
+
+    // stream and sequence of the calling thread's current substream
+    uint32_t current_stream();
+    uint64_t current_sequence();
 
     float random_float();
 
+    double random_double();
+
     int random_int(int min, int max);
 }
 
@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <stdexcept>
+
+#include "sampler.hpp"
+#include "logging.hpp"
+
+static Logger logger("sampler", "INFO");
+
+
+namespace sampler {
+
+    AliasSampler::AliasSampler(std::vector<float> const &weights) : AliasSampler(std::vector<double>(weights.begin(), weights.end())) {}
+
+    AliasSampler::AliasSampler(std::vector<double> const &weights) {
+        // check the weights
+        const size_t n = weights.size();
+        if (n == 0) {
+            logger.critical("Cannot construct a sampler without weights.");
+            throw std::invalid_argument("Cannot construct a sampler without weights.");
+        }
+        double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+        if (!(sum > 0.0)) {
+            logger.critical("The weights of a sampler must have a positive sum.");
+            throw std::invalid_argument("The weights of a sampler must have a positive sum.");
+        }
+
+        // scale the weights such that the mean weight is 1
+        std::vector<double> scaled(n);
+        for (size_t i = 0; i < n; i++) {
+            if (weights[i] < 0.0) {
+                logger.critical("The weights of a sampler must not be negative.");
+                throw std::invalid_argument("The weights of a sampler must not be negative.");
+            }
+            scaled[i] = weights[i] * n / sum;
+        }
+
+        // sort the buckets into those below and above the mean weight
+        std::vector<uint32_t> small;
+        std::vector<uint32_t> large;
+        for (size_t i = 0; i < n; i++) {
+            if (scaled[i] < 1.0) {
+                small.push_back(i);
+            } else {
+                large.push_back(i);
+            }
+        }
+
+        // fill each small bucket up with the excess of a large bucket
+        _threshold.assign(n, 1.0);
+        _alias.resize(n);
+        std::iota(_alias.begin(), _alias.end(), 0);
+        while (!small.empty() && !large.empty()) {
+            uint32_t i_small = small.back();
+            small.pop_back();
+            uint32_t i_large = large.back();
+
+            _threshold[i_small] = scaled[i_small];
+            _alias[i_small] = i_large;
+            scaled[i_large] -= 1.0 - scaled[i_small];
+            if (scaled[i_large] < 1.0) {
+                large.pop_back();
+                small.push_back(i_large);
+            }
+        }
+
+        // the remaining buckets are full up to rounding errors
+        for (uint32_t i : small) {
+            _threshold[i] = 1.0;
+        }
+        for (uint32_t i : large) {
+            _threshold[i] = 1.0;
+        }
+    }
+
+} // namespace sampler
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+namespace sampler {
+
+    // samples indices from a discrete distribution in constant time using Walker's alias method,
+    // with the tables constructed by Vose's algorithm (Vose, IEEE Trans. Softw. Eng. 17, 1991)
+    class AliasSampler {
+        private:
+            std::vector<float> _threshold; // probability to keep the drawn bucket instead of its alias
+            std::vector<uint32_t> _alias;
+
+        public:
+            AliasSampler() = default;
+            AliasSampler(std::vector<float> const &weights);
+            AliasSampler(std::vector<double> const &weights);
+
+            template <typename Iterator>
+            AliasSampler(Iterator first, Iterator last) : AliasSampler(std::vector<double>(first, last)) {}
+
+            size_t size() const { return _alias.size(); }
+
+            // draw an index with probability proportional to its weight
+            template <class Generator>
+            uint32_t operator()(Generator &generator) const {
+                uint32_t bucket = ((uint64_t)(uint32_t)generator() * _alias.size()) >> 32;
+                float u = (float)((uint32_t)generator() >> 8) * 0x1.0p-24f;
+                return u < _threshold[bucket] ? bucket : _alias[bucket];
+            }
+    };
+
+} // namespace sampler
+
+
+#endif // SAMPLER_HPP
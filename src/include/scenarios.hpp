@@ -10,6 +10,14 @@
 namespace scenarios {
 
 
+    // add mutators as a single chain whose types are fixed at compile time, which only pays off for the reads, where the
+    // chain is applied to every read and each call is cheap
+    template <typename... Mutators>
+    void add_chain(std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators, Mutators... chained) {
+        mutators.push_back(std::make_unique<mutator::MutatorChain<Mutators...>>(std::move(chained)...));
+    }
+
+
     void challenge_decay(
         float& initial_coverage_bias,
         float& mean_physical_coverage,
@@ -24,7 +32,7 @@ namespace scenarios {
         mean_sequencing_coverage = 30;
         read_length = 150;
 
-        // mutators for synthesis + aging
+        // mutators for synthesis + aging, fragments are size-selected as soon as they are cut off
         initial_mutators.push_back(std::make_unique<mutator::SubstitutionEvents>(
             0.000109*15, // 15 cycles of PCR amplification with Taq polymerase
             std::vector<float>{0.0147, 0.3028, 0.0630, 0.0150, 0.0071, 0.0975, 0.0975, 0.0071, 0.0150, 0.0630, 0.3028, 0.0147}
@@ -38,15 +46,17 @@ namespace scenarios {
             // length bias     1       2       3       4       5       6       7       8       9       10      11      12      13      14      15      16
         ));
         initial_mutators.push_back(std::make_unique<mutator::AddReverseComplement>());
-        initial_mutators.push_back(std::make_unique<mutator::BreakageEvents>(
-            0.023, // Aging for five half-lives at 150 nt is equivalent to this per-base rate
-            std::vector<float>{0.3902, 0.0488, 0.4878, 0.0732}
-            // base bias       A       C       G       T
-        ));
-        initial_mutators.push_back(std::make_unique<mutator::SizeSelection>(
-            // Bead-based purification with bead ratio of 1.8, considering the adapter length of 33 nt + 8 nt tail
-            60-33-8, // lower cutoff
-            140-33-8 // upper threshold
+        initial_mutators.push_back(std::make_unique<mutator::BreakageSelection>(
+            mutator::BreakageEvents(
+                0.023, // Aging for five half-lives at 150 nt is equivalent to this per-base rate
+                std::vector<float>{0.3902, 0.0488, 0.4878, 0.0732}
+                // base bias       A       C       G       T
+            ),
+            mutator::SizeSelection(
+                // Bead-based purification with bead ratio of 1.8, considering the adapter length of 33 nt + 8 nt tail
+                60-33-8, // lower cutoff
+                140-33-8 // upper threshold
+            )
         ));
         initial_mutators.push_back(std::make_unique<mutator::Tailing>(
             "CT", // Tailing of the single-stranded workflow introduces a CT adapter
@@ -59,6 +69,10 @@ namespace scenarios {
             std::vector<float>{0.0147, 0.3028, 0.0630, 0.0150, 0.0071, 0.0975, 0.0975, 0.0071, 0.0150, 0.0630, 0.3028, 0.0147}
             // base bias       A2C     A2G     A2T     C2A     C2G     C2T     G2A     G2C     G2T    T2A     T2C     T2G
         ));
+
+        // adjacent substitutions, deletions and insertions are applied in a single pass
+        mutator::fuse_error_channels(initial_mutators);
+        mutator::fuse_error_channels(recovery_mutators);
     }
 
 
@@ -109,6 +123,10 @@ namespace scenarios {
             std::vector<float>{0.0147, 0.3028, 0.0630, 0.0150, 0.0071, 0.0975, 0.0975, 0.0071, 0.0150, 0.0630, 0.3028, 0.0147}
             // base bias       A2C     A2G     A2T     C2A     C2G     C2T     G2A     G2C     G2T    T2A     T2C     T2G
         ));
+
+        // adjacent substitutions, deletions and insertions are applied in a single pass
+        mutator::fuse_error_channels(initial_mutators);
+        mutator::fuse_error_channels(recovery_mutators);
     }
 
 
@@ -119,24 +137,38 @@ namespace scenarios {
         int read_length,
         std::vector<std::unique_ptr<mutator::BaseMutator>>& mutators
     ) {
-        if (add_adapters) {
-            mutators.push_back(std::make_unique<mutator::SequencingAddAdapter>(
+        // the reads are mutated per read, with a chain for each combination of adapters and padding, such that whole
+        // batches of reads pass through the adapter and padding in a single pass before their substitutions
+        auto adapter = []() {
+            return mutator::SequencingAddAdapter(
                 "AGATCGGAAGAGC" // General Illumina read adapter (already rc'ed)
-            ));
-        }
-        if (pad_and_trim) {
-            mutators.push_back(std::make_unique<mutator::SequencingPadTrim>(
+            );
+        };
+        auto pad_trim = [read_length]() {
+            return mutator::SequencingPadTrim(
                 read_length // Pad + trim to the read length
-            ));
+            );
+        };
+        auto substitutions = []() {
+            return mutator::SubstitutionEvents(
+                0.0018115, // iSeq 100 sequencing, error rate averaged over both reads
+                std::vector<float>{0.0029, 0.2065, 0.1684, 0.0246, 0.0139, 0.1594, 0.1761, 0.0184, 0.0377, 0.0203, 0.1060, 0.0657}
+                // base bias       A2C     A2G     A2T     C2A     C2G     C2T     G2A     G2C     G2T    T2A     T2C     T2G
+            );
+        };
+
+        if (add_adapters && pad_and_trim) {
+            add_chain(mutators, adapter(), pad_trim(), substitutions());
+        } else if (add_adapters) {
+            add_chain(mutators, adapter(), substitutions());
+        } else if (pad_and_trim) {
+            add_chain(mutators, pad_trim(), substitutions());
+        } else {
+            add_chain(mutators, substitutions());
         }
-        mutators.push_back(std::make_unique<mutator::SubstitutionEvents>(
-            0.0018115, // iSeq 100 sequencing, error rate averaged over both reads
-            std::vector<float>{0.0029, 0.2065, 0.1684, 0.0246, 0.0139, 0.1594, 0.1761, 0.0184, 0.0377, 0.0203, 0.1060, 0.0657}
-            // base bias       A2C     A2G     A2T     C2A     C2G     C2T     G2A     G2C     G2T    T2A     T2C     T2G
-        ));
     }
 
 }
 
 
-#endif // SCENARIOS_HPP
\ No newline at end of file
+#endif // SCENARIOS_HPP
@@ -0,0 +1,203 @@
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <stdexcept>
+#include <chrono>
+
+#include "threadpool.hpp"
+#include "logging.hpp"
+
+static Logger logger("threadpool", "INFO");
+
+
+namespace threadpool {
+
+    ThreadPool::ThreadPool(int n_threads) {
+        if (n_threads < 1) {
+            logger.critical("Number of threads must be at least 1, got {}", n_threads);
+            throw std::invalid_argument("Number of threads must be at least 1, got " + std::to_string(n_threads));
+        }
+        this->n_threads = n_threads;
+        _stats.resize(n_threads);
+        for (int i = 0; i < n_threads; i++) {
+            _queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (int i = 0; i < n_threads; i++) {
+            _workers.emplace_back(&ThreadPool::_worker_loop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        // signal the workers to stop and wait for them to finish
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _aborted = true;
+            _cv_done.wait(lock, [this] { return _n_busy == 0; });
+            _stop = true;
+        }
+        _cv_start.notify_all();
+        for (std::thread &worker : _workers) {
+            worker.join();
+        }
+    }
+
+    // take the next item from the worker's own queue
+    bool ThreadPool::_pop_own(int i_worker, size_t& item) {
+        WorkerQueue& queue = *_queues[i_worker];
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.items.empty()) {
+            return false;
+        }
+        item = queue.items.front();
+        queue.items.pop_front();
+        _n_unclaimed--;
+        return true;
+    }
+
+    // take an item from another worker's queue, starting with the next worker
+    bool ThreadPool::_steal(int i_worker, size_t& item) {
+        for (int i = 1; i < n_threads; i++) {
+            WorkerQueue& queue = *_queues[(i_worker + i) % n_threads];
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            if (queue.items.empty()) {
+                continue;
+            }
+            item = queue.items.back();
+            queue.items.pop_back();
+            _n_unclaimed--;
+            return true;
+        }
+        return false;
+    }
+
+    // main loop of each worker thread
+    void ThreadPool::_worker_loop(int i_worker) {
+        WorkerStats& stats = _stats[i_worker];
+        unsigned long last_generation = 0;
+        std::chrono::steady_clock::time_point idle_start = std::chrono::steady_clock::now();
+        while (true) {
+            // wait for a new job or the stop signal
+            std::function<void(size_t)> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv_start.wait(lock, [this, last_generation] { return _stop || _generation != last_generation; });
+                if (_stop) {
+                    return;
+                }
+                last_generation = _generation;
+                task = _task;
+            }
+
+            // work through the own queue, then help the others until all items are claimed
+            size_t item;
+            while (_n_unclaimed > 0 && !_aborted) {
+                bool stolen = false;
+                if (!_pop_own(i_worker, item)) {
+                    if (!_steal(i_worker, item)) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    stolen = true;
+                }
+
+                std::chrono::steady_clock::time_point busy_start = std::chrono::steady_clock::now();
+                stats.idle_seconds += std::chrono::duration<double>(busy_start - idle_start).count();
+                try {
+                    task(item);
+                } catch (...) {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    if (!_exception) {
+                        _exception = std::current_exception();
+                    }
+                    _aborted = true; // skip the remaining items
+                }
+                idle_start = std::chrono::steady_clock::now();
+                stats.busy_seconds += std::chrono::duration<double>(idle_start - busy_start).count();
+                stats.n_items++;
+                if (stolen) {
+                    stats.n_stolen++;
+                }
+            }
+
+            // report that this worker is done with the job
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _n_busy--;
+                if (_n_busy == 0) {
+                    _cv_done.notify_all();
+                }
+            }
+        }
+    }
+
+    // start processing items 0..n_items-1 with the task, returns immediately
+    void ThreadPool::start(size_t n_items, std::function<void(size_t)> task) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_running) {
+                logger.critical("Cannot start a new job while the previous one is still running");
+                throw std::runtime_error("Cannot start a new job while the previous one is still running");
+            }
+            _task = std::move(task);
+
+            // hand each worker a contiguous range of the items
+            for (int i = 0; i < n_threads; i++) {
+                WorkerQueue& queue = *_queues[i];
+                std::unique_lock<std::mutex> queue_lock(queue.mutex);
+                queue.items.clear();
+                for (size_t item = n_items * i / n_threads; item < n_items * (i + 1) / n_threads; item++) {
+                    queue.items.push_back(item);
+                }
+            }
+            _n_unclaimed = n_items;
+            _aborted = false;
+            _n_busy = _workers.size();
+            _running = true;
+            _generation++;
+        }
+        _cv_start.notify_all();
+    }
+
+    // block until the current job is finished, rethrows exceptions from the workers
+    void ThreadPool::wait() {
+        std::exception_ptr exception;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_running) {
+                return;
+            }
+            _cv_done.wait(lock, [this] { return _n_busy == 0; });
+            _running = false;
+            std::swap(exception, _exception);
+        }
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    // process items 0..n_items-1 with the task and block until finished
+    void ThreadPool::parallel_for(size_t n_items, std::function<void(size_t)> task) {
+        start(n_items, std::move(task));
+        wait();
+    }
+
+    // statistics of each worker, accumulated over all jobs
+    std::vector<WorkerStats> ThreadPool::get_stats() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _stats;
+    }
+
+    // log the statistics of each worker
+    void ThreadPool::log_stats() {
+        std::vector<WorkerStats> all_stats = get_stats();
+        for (int i = 0; i < n_threads; i++) {
+            const WorkerStats& stats = all_stats[i];
+            double total_seconds = stats.busy_seconds + stats.idle_seconds;
+            logger.info("Worker {}: {} tasks ({} stolen), busy for {:.2f} s, idle for {:.2f} s ({:.1f}%)", 
+                i, stats.n_items, stats.n_stolen, stats.busy_seconds, stats.idle_seconds, 
+                total_seconds > 0 ? 100.0 * stats.idle_seconds / total_seconds : 0.0
+            );
+        }
+    }
+
+} // namespace threadpool
@@ -0,0 +1,85 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+
+
+namespace threadpool {
+
+    // statistics on the work done by a single worker thread
+    struct WorkerStats {
+        size_t n_items = 0;
+        size_t n_stolen = 0;
+        double busy_seconds = 0.0;
+        double idle_seconds = 0.0;
+    };
+
+    // pool of worker threads that process the items of a job in parallel
+    // each worker gets a contiguous range of the items in its own queue and works through it
+    // from the front, while idle workers steal items from the back of other workers' queues
+    class ThreadPool {
+        private:
+            struct WorkerQueue {
+                std::mutex mutex;
+                std::deque<size_t> items;
+            };
+
+            std::vector<std::thread> _workers;
+            std::vector<std::unique_ptr<WorkerQueue>> _queues;
+            std::vector<WorkerStats> _stats;
+            std::mutex _mutex;
+            std::condition_variable _cv_start;
+            std::condition_variable _cv_done;
+            std::function<void(size_t)> _task;
+            std::atomic<size_t> _n_unclaimed = 0;
+            std::atomic<bool> _aborted = false;
+            int _n_busy = 0;
+            bool _running = false;
+            bool _stop = false;
+            unsigned long _generation = 0;
+            std::exception_ptr _exception;
+
+            // main loop of each worker thread
+            void _worker_loop(int i_worker);
+
+            // take the next item from the worker's own queue
+            bool _pop_own(int i_worker, size_t& item);
+
+            // take an item from another worker's queue
+            bool _steal(int i_worker, size_t& item);
+
+        public:
+            int n_threads;
+
+            ThreadPool(int n_threads);
+
+            ~ThreadPool();
+
+            // start processing items 0..n_items-1 with the task, returns immediately
+            void start(size_t n_items, std::function<void(size_t)> task);
+
+            // block until the current job is finished, rethrows exceptions from the workers
+            void wait();
+
+            // process items 0..n_items-1 with the task and block until finished
+            void parallel_for(size_t n_items, std::function<void(size_t)> task);
+
+            // statistics of each worker, accumulated over all jobs
+            std::vector<WorkerStats> get_stats();
+
+            // log the statistics of each worker
+            void log_stats();
+    };
+
+} // namespace threadpool
+
+
+#endif // THREADPOOL_HPP